@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <libsdb/dwarf.hpp>
+#include <libsdb/elf.hpp>
+#include <libsdb/error.hpp>
+
+/*
+  dwarf_index_bench [program | units]
+
+  Measures how long building a dwarf_index over every compile unit takes with
+  1, 2, 4, ... threads up to the number of cores. Without a program, one is
+  generated from units (default 256) C++ files that each pull in a few
+  standard headers, which gives each unit a few thousand DIEs like real code.
+  Programs must be built with -gdwarf-4.
+*/
+
+namespace {
+  void run(const std::string& command) {
+    if (std::system(command.c_str()) != 0) sdb::error::send("Command failed: " + command);
+  }
+
+  std::filesystem::path generate_program(const std::filesystem::path& dir, std::size_t units) {
+    for (std::size_t i = 0; i < units; ++i) {
+      std::ofstream out(dir / ("unit" + std::to_string(i) + ".cpp"));
+      out << "#include <map>\n#include <string>\n#include <vector>\n"
+          << "namespace unit" << i << " {\n"
+          << "  struct record { std::string name; std::vector<int> values; };\n"
+          << "  std::map<std::string, record> records;\n"
+          << "  int add(const std::string& name, int value) {\n"
+          << "    records[name].values.push_back(value);\n"
+          << "    return static_cast<int>(records.size());\n"
+          << "  }\n"
+          << "}\n"
+          << "int unit" << i << "_entry() { return unit" << i << "::add(\"x\", " << i << "); }\n";
+    }
+
+    std::ofstream out(dir / "main.cpp");
+    for (std::size_t i = 0; i < units; ++i) out << "int unit" << i << "_entry();\n";
+    out << "int main() {\n  int sum = 0;\n";
+    for (std::size_t i = 0; i < units; ++i) out << "  sum += unit" << i << "_entry();\n";
+    out << "  return sum == 0;\n}\n";
+    out.close();
+
+    // Compiling is by far the slowest part, so it gets every core too
+    std::atomic<std::size_t> next_unit = 0;
+    std::atomic<bool> failed = false;
+    auto worker = [&] {
+      for (auto i = next_unit++; i <= units; i = next_unit++) {
+        auto name = i == units ? std::string("main") : "unit" + std::to_string(i);
+        auto command = "c++ -g -gdwarf-4 -O0 -c " + (dir / (name + ".cpp")).string() +
+                       " -o " + (dir / (name + ".o")).string();
+        if (std::system(command.c_str()) != 0) failed = true;
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) thread.join();
+    if (failed) sdb::error::send("Could not compile the generated program");
+
+    auto program = dir / "program";
+    run("c++ -o " + program.string() + " " + (dir / "*.o").string());
+    return program;
+  }
+
+  double index_seconds(const sdb::dwarf& dwarf, std::size_t n_threads, std::size_t& die_count) {
+    auto start = std::chrono::steady_clock::now();
+    sdb::dwarf_index index(dwarf, n_threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    die_count = index.die_count();
+    return elapsed.count();
+  }
+}
+
+int main(int argc, const char** argv) {
+  std::string arg = argc > 1 ? argv[1] : "256";
+  bool generate = !arg.empty() and std::all_of(begin(arg), end(arg), [](char c) { return std::isdigit(c); });
+
+  try {
+    std::filesystem::path program;
+    std::filesystem::path temp_dir;
+    if (!generate) {
+      program = arg;
+    } else {
+      temp_dir = std::filesystem::temp_directory_path() / ("dwarf_index_bench." + std::to_string(getpid()));
+      std::filesystem::create_directories(temp_dir);
+      auto units = std::stoul(arg);
+      std::cout << "generating " << units << " compile units in " << temp_dir.string() << '\n';
+      program = generate_program(temp_dir, units);
+    }
+
+    sdb::elf elf(program);
+    sdb::dwarf dwarf(elf);
+    std::cout << "compile units: " << dwarf.compile_units().size() << '\n';
+
+    std::size_t die_count = 0;
+    // Untimed, so every run sees .debug_info already paged in
+    index_seconds(dwarf, 1, die_count);
+    std::cout << "DIEs:          " << die_count << '\n';
+
+    auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+    double serial = 0;
+    for (std::size_t n_threads = 1; ; n_threads = std::min<std::size_t>(n_threads * 2, max_threads)) {
+      auto seconds = index_seconds(dwarf, n_threads, die_count);
+      if (n_threads == 1) serial = seconds;
+      std::cout << n_threads << " threads: " << seconds * 1000 << " ms, "
+                << serial / seconds << "x\n";
+      if (n_threads == max_threads) break;
+    }
+
+    if (!temp_dir.empty()) std::filesystem::remove_all(temp_dir);
+  } catch (const sdb::error& err) {
+    std::cout << err.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/personality.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include <libsdb/error.hpp>
+#include <libsdb/pipe.hpp>
+#include <libsdb/process.hpp>
+#include <libsdb/target_pool.hpp>
+
+/*
+  launch_bench <program> [iterations] [resident MiB]
+
+  Measures debuggee launches per second, each run to exit under ptrace,
+  for process::launch, for the fork + execlp launcher it replaced and for
+  clones handed out by a target_pool.
+  Resident MiB of touched heap inflates sdb's page tables the way large
+  symbol tables do, which is where fork's copying shows up.
+*/
+
+namespace {
+  // The previous process::launch, kept here as the baseline
+  pid_t fork_launch(const char* path) {
+    sdb::pipe channel(/*close_on_exec=*/true);
+
+    pid_t pid = fork();
+    if (pid < 0) sdb::error::send_errno("fork failed");
+
+    if (pid == 0) {
+      setpgid(0, 0);
+      personality(ADDR_NO_RANDOMIZE);
+      channel.close_read();
+      if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0 or execlp(path, path, nullptr) < 0) {
+        auto message = std::string("launch failed: ") + std::strerror(errno);
+        channel.write(reinterpret_cast<std::byte*>(message.data()), message.size());
+        exit(-1);
+      }
+    }
+
+    channel.close_write();
+    auto data = channel.read();
+    if (data.size() > 0) {
+      waitpid(pid, nullptr, 0);
+      sdb::error::send(std::string(reinterpret_cast<char*>(data.data()), data.size()));
+    }
+
+    waitpid(pid, nullptr, 0);
+    return pid;
+  }
+
+  void run_to_exit(pid_t pid) {
+    int status;
+    do {
+      ptrace(PTRACE_CONT, pid, nullptr, nullptr);
+      waitpid(pid, &status, 0);
+    } while (WIFSTOPPED(status));
+  }
+
+  template <class F>
+  double launches_per_second(int iterations, F launch_once) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) launch_once();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return iterations / elapsed.count();
+  }
+}
+
+int main(int argc, const char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: launch_bench <program> [iterations] [resident MiB]\n";
+    return -1;
+  }
+
+  auto program = argv[1];
+  int iterations = argc > 2 ? std::stoi(argv[2]) : 1000;
+  std::size_t resident_mib = argc > 3 ? std::stoul(argv[3]) : 0;
+
+  std::vector<char> ballast(resident_mib * 1024 * 1024);
+  for (std::size_t i = 0; i < ballast.size(); i += 4096) ballast[i] = 1;
+
+  try {
+    auto clone_rate = launches_per_second(iterations, [&] {
+      auto proc = sdb::process::launch(program);
+      proc->resume();
+      proc->wait_on_signal();
+    });
+
+    auto fork_rate = launches_per_second(iterations, [&] {
+      run_to_exit(fork_launch(program));
+    });
+
+    sdb::target_pool pool(program);
+    auto pool_rate = launches_per_second(iterations, [&] {
+      auto target = pool.acquire();
+      target->get_process().resume();
+      target->get_process().wait_on_signal();
+    });
+
+    std::cout << "resident ballast:   " << resident_mib << " MiB\n";
+    std::cout << "clone(CLONE_VFORK): " << clone_rate << " launches/s\n";
+    std::cout << "fork + execlp:      " << fork_rate << " launches/s\n";
+    std::cout << "target_pool:        " << pool_rate << " launches/s\n";
+  } catch (const sdb::error& err) {
+    std::cout << err.what() << '\n';
+    return -1;
+  }
+}
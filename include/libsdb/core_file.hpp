@@ -0,0 +1,70 @@
+#ifndef SDB_CORE_FILE_HPP
+#define SDB_CORE_FILE_HPP
+
+#include <elf.h>
+#include <filesystem>
+#include <optional>
+#include <sys/user.h>
+#include <unordered_map>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  /*
+    Read-only view of an ELF core file. The file is mmapped and only the program
+    headers and notes are parsed up front, so opening is independent of the core's size.
+  */
+  class core_file {
+    public:
+      explicit core_file(const std::filesystem::path& path);
+      ~core_file();
+
+      core_file(const core_file&) = delete;
+      core_file& operator=(const core_file&) = delete;
+
+      std::filesystem::path path() const { return path_; }
+
+      pid_t pid() const { return pid_; }
+      int signal() const { return signal_; }
+      const user_regs_struct& gprs() const { return gprs_; }
+      const user_fpregs_struct& fprs() const { return fprs_; }
+      const std::unordered_map<int, std::uint64_t>& auxv() const { return auxv_; }
+
+      // Zero-copy view of [address, address + size) if it lies within the
+      // file contents of a single segment
+      std::optional<span<const std::byte>> view(virt_addr address, std::size_t size) const;
+
+      // Copies [address, address + size) out of the mapping, spanning segments as needed.
+      // Throws if part of the range was not saved in the core.
+      std::vector<std::byte> read_memory(virt_addr address, std::size_t size) const;
+
+      struct segment {
+        virt_addr start;
+        virt_addr end;
+        std::uint64_t offset;
+        std::uint64_t file_size;
+        Elf64_Word flags;
+      };
+      const std::vector<segment>& segments() const { return segments_; }
+
+    private:
+      void parse_notes(const Elf64_Phdr& phdr);
+      const segment* segment_containing(virt_addr address) const;
+
+      int fd_;
+      std::filesystem::path path_;
+      std::size_t file_size_;
+      std::byte* data_;
+
+      // Sorted by start address so lookups are a binary search
+      std::vector<segment> segments_;
+
+      pid_t pid_ = 0;
+      int signal_ = 0;
+      user_regs_struct gprs_{};
+      user_fpregs_struct fprs_{};
+      std::unordered_map<int, std::uint64_t> auxv_;
+  };
+}
+
+#endif
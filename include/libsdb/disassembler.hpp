@@ -1,6 +1,7 @@
 #ifndef SDB_DISASSEMBLER_HPP
 #define SDB_DISASSEMBLER_HPP
 
+#include <libsdb/elf.hpp>
 #include <libsdb/process.hpp>
 #include <optional>
 
@@ -16,6 +17,20 @@ namespace sdb {
 
       std::vector<instruction> disassemble(std::size_t n_instructions, std::optional<virt_addr> address = std::nullopt);
 
+      // Disassembles straight from an object file's mapping, so no process is needed and
+      // no inferior memory is read. Addresses are reported relative to the elf's load bias.
+      static std::vector<instruction> disassemble(const elf& obj, file_addr address, std::size_t n_instructions);
+
+      struct memory_range {
+        virt_addr address;
+        std::size_t size;
+      };
+
+      // Memory that the instruction at the PC may write when executed, worked out from its
+      // decoded operands and the current register values. Implicit stack operands and
+      // syscalls are over-approximated, so the ranges may cover bytes that are left unchanged.
+      std::vector<memory_range> memory_writes();
+
     private:
       process* process_;
   };
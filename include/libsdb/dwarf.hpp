@@ -2,19 +2,24 @@
 #define SDB_DWARF_HPP
 
 #include <libsdb/detail/dwarf.h>
+#include <libsdb/elf.hpp>
 #include <libsdb/types.hpp>
 
 #include <cstdint>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
 namespace sdb {
   class compile_unit;
-  
+
   struct attr_spec {
     std::uint64_t attr;
-    std::uint64_t form;  
+    std::uint64_t form;
   };
 
   struct abbrev {
@@ -22,6 +27,44 @@ namespace sdb {
     std::uint64_t tag;
     bool has_children;
     std::vector<attr_spec> attr_specs;
+
+    /*
+      Offsets of the leading attributes from the end of the abbreviation code, for as
+      many attributes as have only fixed-size forms before them. Later attributes are
+      found by skipping forward from the last of these.
+    */
+    std::vector<std::uint32_t> fixed_offsets;
+    // Size of all the attributes together, if every form has a fixed size
+    std::optional<std::uint32_t> fixed_size;
+  };
+
+  /*
+    Abbreviation codes are almost always numbered 1 to N, so entries are stored in a vector
+    indexed by code and finding one is a bounds check. Codes far past the number of entries
+    so far, which would leave most of the vector empty, go in a map instead.
+  */
+  class abbrev_table {
+    public:
+      // nullptr if the table has no entry for code
+      const abbrev* find(std::uint64_t code) const {
+        if (code - 1 < dense_.size() and dense_[code - 1].code != 0) return &dense_[code - 1];
+        if (sparse_.empty()) return nullptr;
+        auto it = sparse_.find(code);
+        return it == sparse_.end() ? nullptr : &it->second;
+      }
+      // Throws if the table has no entry for code
+      const abbrev& at(std::uint64_t code) const;
+
+      std::size_t size() const { return size_; }
+
+      // Entries must all be added before any are looked up, since adding may move them
+      void add(abbrev entry);
+
+    private:
+      // Holes have a code of 0, which no entry can have
+      std::vector<abbrev> dense_;
+      std::unordered_map<std::uint64_t, abbrev> sparse_;
+      std::size_t size_ = 0;
   };
 
   class die;
@@ -33,49 +76,195 @@ namespace sdb {
 
       const dwarf* dwarf_info() const { return parent_; }
       span<const std::byte> data() const { return data_; }
+      std::size_t abbrev_offset() const { return abbrev_offset_; }
 
-      const std::unordered_map<std::uint64_t, sdb::abbrev>& abbrev_table() const;
+      const sdb::abbrev_table& abbrev_table() const { return *abbrev_table_; }
       die root() const;
 
     private:
+      friend dwarf;
+
       dwarf* parent_;
       span<const std::byte> data_;
       std::size_t abbrev_offset_;
+      // Set by the dwarf once every table is parsed, so DIEs don't look the table up by offset
+      const sdb::abbrev_table* abbrev_table_ = nullptr;
+  };
+
+  class attr {
+    public:
+      attr(const compile_unit* cu, std::uint64_t type, std::uint64_t form, const std::byte* location)
+        : cu_(cu), type_(type), form_(form), location_(location) {}
+
+      std::uint64_t name() const { return type_; }
+      std::uint64_t form() const { return form_; }
+
+      // Each of these throws if the attribute's form is not one of the forms for that class
+      file_addr as_address() const;
+      std::uint32_t as_section_offset() const;
+      span<const std::byte> as_block() const;
+      // Constants, with DW_FORM_sdata sign-extended to 64 bits
+      std::uint64_t as_int() const;
+      bool as_flag() const;
+      std::string_view as_string() const;
+      // The DIE that a DW_FORM_ref* attribute refers to, which may be in another unit for DW_FORM_ref_addr
+      die as_reference() const;
+
+    private:
+      const compile_unit* cu_;
+      std::uint64_t type_;
+      std::uint64_t form_;
+      const std::byte* location_;
   };
 
+  /*
+    A DIE is only a position in .debug_info and its abbreviation, so it is cheap to copy
+    and creating one allocates nothing. Attributes are located through the abbreviation's
+    fixed offsets, falling back to skipping over the forms before them.
+  */
   class die {
     public:
       explicit die(const std::byte* next) : next_(next) {}
-      die(const std::byte* pos, const compile_unit* cu, const abbrev* abbrev, std::vector<const std::byte*> attr_locs, const std::byte* next)
-        : pos_(pos), cu_(cu), abbrev_(abbrev), attr_locs_(std::move(attr_locs)), next_(next) {}
+      die(const std::byte* pos, const compile_unit* cu, const abbrev* abbrev, const std::byte* attrs, const std::byte* next)
+        : pos_(pos), cu_(cu), abbrev_(abbrev), attrs_(attrs), next_(next) {}
 
       const compile_unit* cu() const { return cu_; }
       const abbrev* abbrev_entry() const { return abbrev_; }
       const std::byte* position() const { return pos_; }
       const std::byte* next() const { return next_; }
 
+      // Null DIEs end each list of siblings
+      bool is_null() const { return abbrev_ == nullptr; }
+      std::uint64_t tag() const { return abbrev_->tag; }
+
+      bool contains(std::uint64_t attribute) const;
+      // Throws if the DIE has no such attribute
+      attr operator[](std::uint64_t attribute) const;
+
+      // Where the next sibling starts, found through DW_AT_sibling if present or
+      // otherwise by walking past all of this DIE's descendants
+      const std::byte* sibling_position() const;
+
+      class children_range;
+      children_range children() const;
+
     private:
+      const std::byte* attr_location(std::size_t index) const;
+
       const std::byte* pos_ = nullptr;
       const compile_unit* cu_ = nullptr;
       const abbrev* abbrev_ = nullptr;
+      const std::byte* attrs_ = nullptr;
       const std::byte* next_ = nullptr;
-      std::vector<const std::byte*> attr_locs_;
   };
-  
-  class elf;
+
+  class die::children_range {
+    public:
+      explicit children_range(die parent) : parent_(parent) {}
+
+      class iterator {
+        public:
+          using value_type = die;
+          using reference = const die&;
+          using pointer = const die*;
+          using difference_type = std::ptrdiff_t;
+          using iterator_category = std::forward_iterator_tag;
+
+          iterator() = default;
+          // The end iterator is the null DIE, or nothing if the parent has no children
+          explicit iterator(std::optional<die> current) : die_(current) {}
+
+          const die& operator*() const { return *die_; }
+          const die* operator->() const { return &*die_; }
+
+          iterator& operator++();
+          iterator operator++(int) { auto tmp = *this; ++(*this); return tmp; }
+
+          bool operator==(const iterator& rhs) const;
+          bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+
+        private:
+          std::optional<die> die_;
+      };
+
+      iterator begin() const;
+      iterator end() const { return iterator{ std::nullopt }; }
+
+    private:
+      die parent_;
+  };
+
+  /*
+    Name and address indexes over every compile unit. Units are handed out to worker
+    threads one at a time from a shared counter, so threads that finish small units
+    early keep taking more. Each thread collects and sorts its own results, and the
+    sorted runs are merged pairwise, again in parallel.
+  */
+  class dwarf_index {
+    public:
+      // n_threads of 0 uses one thread per core
+      explicit dwarf_index(const dwarf& parent, std::size_t n_threads = 0);
+
+      // Lookups are by unqualified name. Only definitions are indexed: functions with
+      // code, variables at file or namespace scope, and types that aren't declarations.
+      std::vector<die> find_functions(std::string_view name) const;
+      std::vector<die> find_variables(std::string_view name) const;
+      std::vector<die> find_types(std::string_view name) const;
+
+      // The function whose DW_AT_low_pc to DW_AT_high_pc range contains address
+      std::optional<die> function_containing_address(file_addr address) const;
+
+      std::size_t die_count() const { return die_count_; }
+
+      struct named_die {
+        std::string_view name;
+        die entry;
+      };
+      struct function_range {
+        std::uint64_t low;
+        std::uint64_t high;
+        die function;
+      };
+
+    private:
+      // Sorted by name, then by position so that results don't depend on the thread count
+      std::vector<named_die> functions_;
+      std::vector<named_die> variables_;
+      std::vector<named_die> types_;
+      // Sorted by low address
+      std::vector<function_range> function_ranges_;
+      std::size_t die_count_ = 0;
+  };
+
   class dwarf {
     public:
       dwarf(const elf& parent);
       const elf* elf_file() const { return elf_; }
 
-      const std::unordered_map<std::uint64_t, abbrev>& get_abbrev_table(std::size_t offset);
+      // Every table is parsed up front, so this only reads and is safe to call from any thread
+      const abbrev_table& get_abbrev_table(std::size_t offset) const;
 
       const std::vector<std::unique_ptr<compile_unit>>& compile_units() const { return compile_units_; }
 
+      // The unit whose data contains position, which must point into .debug_info
+      const compile_unit* compile_unit_containing(const std::byte* position) const;
+
+      span<const std::byte> debug_info() const { return debug_info_.bytes; }
+      span<const std::byte> debug_str() const { return debug_str_.bytes; }
+
+      // Built on first use, on every core
+      const dwarf_index& index() const;
+
     private:
       const elf* elf_;
-      std::unordered_map<std::size_t, std::unordered_map<std::uint64_t, abbrev>> abbrev_tables_;
+      // Compile units and DIEs point into these, so they are held for as long as the dwarf is
+      elf::section_data debug_info_;
+      elf::section_data debug_str_;
+      std::unordered_map<std::size_t, abbrev_table> abbrev_tables_;
       std::vector<std::unique_ptr<compile_unit>> compile_units_;
+
+      mutable std::once_flag index_built_;
+      mutable std::unique_ptr<dwarf_index> index_;
   };
 };
 
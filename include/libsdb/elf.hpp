@@ -1,75 +1,351 @@
 #ifndef SDB_ELF_HPP
 #define SDB_ELF_HPP
 
+#include <atomic>
 #include <filesystem>
 #include <elf.h>
+#include <future>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
+#include <libsdb/index_cache.hpp>
 #include <libsdb/types.hpp>
 
 
 namespace sdb {
-  class elf {
+  /*
+    The parsed contents of an ELF file, which never change once opened and so are
+    shared by every elf that refers to the same file; see elf_image::open. Addresses
+    are plain file addresses, since where the file is loaded is up to each elf.
+  */
+  class elf_image {
     public:
-      elf(const std::filesystem::path& path);
-      ~elf();
+      // Returns the image already open for the file at path if there is one, keyed by
+      // device, inode, modification time and size so that rebuilt files are reopened
+      static std::shared_ptr<const elf_image> open(const std::filesystem::path& path);
+      // Parses an image held in memory rather than mapped from a file, such as the vDSO
+      // read out of an inferior. name is only used as the path, and nothing is cached.
+      static std::shared_ptr<const elf_image> from_memory(std::filesystem::path name, std::vector<std::byte> contents);
+      ~elf_image();
 
-      elf(const elf&);
-      elf& operator=(const elf&) = delete;
+      elf_image() = delete;
+      elf_image(const elf_image&) = delete;
+      elf_image& operator=(const elf_image&) = delete;
 
+      // Resolved when the file was opened, so unlike elf::path this doesn't depend on how it was opened
       std::filesystem::path path() const { return path_; }
       const Elf64_Ehdr& get_header() const { return header_; }
 
       std::string_view get_section_name(std::size_t index) const;
+      // Looks up a name in the string table used by the symbol table, which
+      // is the debug file's if symbol lookups are being answered from it
       std::string_view get_string(std::size_t index) const;
 
+      // Points directly into the mapped file, so never covers the debug file
+      span<const Elf64_Shdr> section_headers() const { return section_headers_; }
+      // The symbol table get_string resolves names in, so the debug file's if it has one
+      span<const Elf64_Sym> symbols() const;
+
+      // Hex string of the NT_GNU_BUILD_ID note, if the file has one
+      const std::optional<std::string>& build_id() const { return build_id_; }
+      // Whether each symbol index was loaded from the on-disk index cache
+      bool address_index_from_cache() const { return address_index_from_cache_; }
+      bool name_index_from_cache() const { return name_index_from_cache_; }
+
+      /*
+        Stripped files may have their symbols and DWARF in a separate file, found
+        under /usr/lib/debug/.build-id by build ID or through .gnu_debuglink. It is only
+        searched for, and mapped, the first time a symbol or .debug_* lookup needs it.
+      */
+      const elf_image* debug_file() const;
+
+      /*
+        Section contents along with whatever keeps them alive. Sections compressed with
+        SHF_COMPRESSED are decompressed into an owned buffer on first access, which stays
+        valid for as long as a handle to it exists, even once the cache has dropped it.
+      */
+      struct section_data {
+        span<const std::byte> bytes;
+        // Null for sections used straight from the mapped file
+        std::shared_ptr<const std::vector<std::byte>> owner;
+      };
+
       std::optional<const Elf64_Shdr*> get_section(std::string_view name) const;
+      // .debug_* sections missing from this file are taken from the debug file
+      section_data get_section_data(std::string_view name) const;
+      // Like get_section_data, but a decompressed section is only kept alive by the
+      // cache, so the span may dangle once other compressed sections have been read
       span<const std::byte> get_section_contents(std::string_view name) const;
-      const Elf64_Shdr* get_section_containing_address(file_addr addr) const;
-      const Elf64_Shdr* get_section_containing_address(virt_addr addr) const;
 
-      virt_addr load_bias() const { return load_bias_; }
-      void notify_loaded(virt_addr address) { load_bias_ = address; }
+      // Decompresses every compressed section on a background thread, so that later
+      // lookups find them ready or wait for the one in progress instead of starting over
+      void prefetch_compressed_sections() const;
+      /*
+        Bound on the decompressed bytes each image's cache keeps alive, dropping the least
+        recently used sections first. The last section decompressed is always kept. Images
+        are shared between targets, so the limit is process-wide and applies to every image.
+      */
+      static void set_decompression_cache_limit(std::size_t bytes);
+      static std::size_t decompression_cache_limit();
 
-      std::optional<file_addr> get_section_start_address(std::string_view name) const;
+      // Only allocated sections are considered, since the others have no address
+      const Elf64_Shdr* get_section_containing_address(std::uint64_t address) const;
+
+      span<const Elf64_Phdr> program_headers() const { return program_headers_; }
+      const Elf64_Phdr* get_segment_containing_address(std::uint64_t address) const;
+
+      // Translate between addresses and file offsets through the PT_LOAD segments.
+      // Addresses in the zero-filled tail of a segment, such as .bss, have no offset.
+      std::optional<std::uint64_t> get_file_offset(std::uint64_t address) const;
+      std::optional<std::uint64_t> get_file_addr(std::uint64_t offset) const;
+
+      // The contents of [address, address + size) straight from the mapped file,
+      // or nothing if the range isn't entirely backed by one segment's file contents
+      std::optional<span<const std::byte>> get_bytes(std::uint64_t address, std::size_t size) const;
 
       std::vector<const Elf64_Sym*> get_symbols_by_name(std::string_view name) const;
-      std::optional<const Elf64_Sym*> get_symbol_at_address(file_addr address) const;
-      std::optional<const Elf64_Sym*> get_symbol_at_address(virt_addr address) const;
-      std::optional<const Elf64_Sym*> get_symbol_containing_address(file_addr address) const;
-      std::optional<const Elf64_Sym*> get_symbol_containing_address(virt_addr address) const;
+      std::optional<const Elf64_Sym*> get_symbol_at_address(std::uint64_t address) const;
+      std::optional<const Elf64_Sym*> get_symbol_containing_address(std::uint64_t address) const;
 
+      // Like calling get_symbol_containing_address on each address, but resolving
+      // ascending runs of addresses with a single merge over the symbols
+      std::vector<std::optional<const Elf64_Sym*>> symbolize(span<const std::uint64_t> addresses) const;
 
     private:
+      // Views count entries of T at offset in the file, copying them into fallback
+      // only if they are not suitably aligned to be used in place
+      template <class T>
+      span<const T> view_table(
+        std::uint64_t offset, std::size_t count, std::vector<T>& fallback, const char* what) const;
+      using decompressed_bytes = std::shared_ptr<const std::vector<std::byte>>;
+      decompressed_bytes get_decompressed(const Elf64_Shdr& section) const;
+      decompressed_bytes decompress(const Elf64_Shdr& section) const;
+      // Looks up a name in this file's own symbol string table
+      std::string_view string_at(std::size_t index) const;
       void build_section_map();
       void parse_section_headers();
+      void parse_program_headers();
       void parse_symbol_table();
-      void build_symbol_maps();
+      void set_string_table(const Elf64_Shdr& section);
+      void parse_gnu_hash();
+      std::vector<const Elf64_Sym*> lookup_gnu_hash(std::string_view name) const;
+      void read_build_id();
+      explicit elf_image(const std::filesystem::path& path);
+      // Takes ownership of fd, which must be open on path
+      elf_image(const std::filesystem::path& path, int fd);
+      elf_image(std::filesystem::path name, std::vector<std::byte> contents);
+      void parse();
+
+      std::unique_ptr<elf_image> find_debug_file() const;
+      // The image whose symbol table answers symbol lookups
+      const elf_image* symbol_file() const;
+      std::string cache_key() const;
+      bool load_cached_indexes();
+      bool load_cached_address_index(const index_cache& cache);
+      bool load_cached_name_index(const index_cache& cache);
+      void save_cached_indexes() const;
+      void build_symbol_maps() const;
+      void build_name_index() const;
+      // Index of the last symbol starting at or before address, or npos
+      std::size_t find_symbol_index(std::uint64_t address) const;
+      std::optional<const Elf64_Sym*> symbol_containing(std::size_t index, std::uint64_t address) const;
       
       int fd_;
       std::filesystem::path path_;
       std::size_t file_size_;
       std::byte* data_;
+      // Holds the bytes of an image parsed from memory, in which case fd_ is -1
+      std::vector<std::byte> contents_;
       Elf64_Ehdr header_;
-      std::vector<Elf64_Shdr> section_headers_;
-      std::unordered_map<std::string_view, Elf64_Shdr*> section_map_;
-      virt_addr load_bias_;
-      std::vector<Elf64_Sym> symbol_table_;
-      std::unordered_multimap<std::string_view, Elf64_Sym*> symbol_name_map_;
-
-      struct range_comparator {
-        bool operator()(
-          std::pair<file_addr, file_addr> lhs,
-          std::pair<file_addr, file_addr> rhs
-        ) const {
-          return lhs.first < rhs.first; // Compare the low address
-        }
+      span<const Elf64_Shdr> section_headers_;
+      std::vector<Elf64_Shdr> section_headers_copy_;
+      std::unordered_map<std::string_view, const Elf64_Shdr*> section_map_;
+      span<const Elf64_Phdr> program_headers_;
+      std::vector<Elf64_Phdr> program_headers_copy_;
+      // Allocated sections and loadable segments sorted by address, for binary searches
+      std::vector<const Elf64_Shdr*> sections_by_address_;
+      std::vector<const Elf64_Phdr*> segments_by_address_;
+      span<const Elf64_Sym> symbol_table_;
+      std::vector<Elf64_Sym> symbol_table_copy_;
+      const char* string_table_ = nullptr;
+      std::size_t string_table_size_ = 0;
+
+      // The file's own .gnu.hash table, which answers lookups of exported names
+      // without building anything. Only present when the symbol table is .dynsym.
+      struct gnu_hash_table {
+        std::uint32_t symbol_offset;
+        std::uint32_t bloom_shift;
+        span<const std::uint64_t> bloom;
+        span<const std::uint32_t> buckets;
+        span<const std::uint32_t> chain;
+        // Only used if the table's parts are misaligned in the file
+        std::vector<std::uint32_t> header_copy;
+        std::vector<std::uint64_t> bloom_copy;
+        std::vector<std::uint32_t> buckets_copy;
+        std::vector<std::uint32_t> chain_copy;
+      };
+      std::unique_ptr<gnu_hash_table> gnu_hash_;
+
+      std::optional<std::string> build_id_;
+
+      // Decompressed sections, most recently used first. Entries still being
+      // decompressed have no size yet and are never evicted.
+      struct decompressed_section {
+        const Elf64_Shdr* section;
+        std::shared_future<decompressed_bytes> data;
+        std::size_t size;
       };
+      mutable std::mutex decompression_mutex_;
+      mutable std::list<decompressed_section> decompressed_;
+      mutable std::size_t decompressed_size_ = 0;
+      mutable std::thread prefetch_thread_;
+
+      // Set on debug files themselves so that they never go looking for one
+      bool is_debug_file_ = false;
+      mutable std::once_flag debug_file_found_;
+      mutable std::unique_ptr<elf_image> debug_file_;
+      // Backs the index spans below when they were loaded from disk
+      std::unique_ptr<index_cache> cache_;
+      bool address_index_from_cache_ = false;
+      bool name_index_from_cache_ = false;
+      // Set once each index's spans are filled in, so either can be saved without the other
+      mutable std::atomic<bool> address_index_ready_{ false };
+      mutable std::atomic<bool> name_index_ready_{ false };
+      mutable std::mutex cache_save_mutex_;
+
+      // Built on first use unless loaded from the cache
+      mutable std::once_flag address_index_built_;
+      /*
+        Symbols with addresses, sorted by start address and split into parallel arrays of
+        starts, ends and symbol table indices. Only the first symbol at each start address
+        is kept. The starts are also kept in Eytzinger (breadth-first) order, which puts the
+        first levels of every binary search in the same few cache lines, along with each
+        node's position in the sorted arrays.
+      */
+      mutable span<const std::uint64_t> symbol_starts_;
+      mutable span<const std::uint64_t> symbol_ends_;
+      mutable span<const std::uint32_t> symbols_by_start_;
+      mutable span<const std::uint64_t> start_tree_;
+      mutable span<const std::uint32_t> start_tree_index_;
+
+      /*
+        Lookups by name are served by an open-addressing hash table that is built on first
+        use, since demangling every symbol dominates the cost of loading a large C++ binary.
+        Mangled names are referenced in the string table, and demangled names are kept
+        NUL-separated in an arena.
+      */
+      struct name_entry {
+        std::uint32_t symbol;
+        std::uint32_t in_arena;
+        std::uint32_t offset;
+        std::uint32_t size;
+      };
+      std::string_view entry_name(const name_entry& entry) const;
+
+      mutable std::once_flag name_index_built_;
+      mutable span<const char> demangled_names_;
+      mutable span<const name_entry> name_entries_;
+      mutable span<const std::uint64_t> name_buckets_;
+
+      // Storage for the indexes when they are built rather than loaded from the cache
+      struct index_storage {
+        std::vector<std::uint64_t> symbol_starts;
+        std::vector<std::uint64_t> symbol_ends;
+        std::vector<std::uint32_t> symbols_by_start;
+        std::vector<std::uint64_t> start_tree;
+        std::vector<std::uint32_t> start_tree_index;
+        std::vector<char> demangled_names;
+        std::vector<name_entry> name_entries;
+        std::vector<std::uint64_t> name_buckets;
+      };
+      mutable index_storage built_indexes_;
+  };
 
-      std::map<std::pair<file_addr, file_addr>, Elf64_Sym*, range_comparator> symbol_addr_map_;
+  /*
+    An ELF file as loaded at a particular address. The parsed file is shared with
+    every other elf for the same file, so each one only adds its own load bias,
+    and file addresses only ever belong to the elf they were created from.
+  */
+  class elf {
+    public:
+      // If decompress_in_background is set, compressed sections start being
+      // decompressed straight away; see elf_image::prefetch_compressed_sections
+      explicit elf(const std::filesystem::path& path, bool decompress_in_background = false);
+      explicit elf(std::shared_ptr<const elf_image> image) : image_(std::move(image)), path_(image_->path()) {}
+
+      elf(const elf&) = default;
+      elf& operator=(const elf&) = delete;
+
+      const elf_image& image() const { return *image_; }
+
+      // The path this elf was opened through
+      std::filesystem::path path() const { return path_; }
+      const Elf64_Ehdr& get_header() const { return image_->get_header(); }
+
+      std::string_view get_section_name(std::size_t index) const { return image_->get_section_name(index); }
+      std::string_view get_string(std::size_t index) const { return image_->get_string(index); }
+
+      span<const Elf64_Shdr> section_headers() const { return image_->section_headers(); }
+      span<const Elf64_Sym> symbols() const { return image_->symbols(); }
+
+      const std::optional<std::string>& build_id() const { return image_->build_id(); }
+      bool address_index_from_cache() const { return image_->address_index_from_cache(); }
+      bool name_index_from_cache() const { return image_->name_index_from_cache(); }
+      const elf_image* debug_file() const { return image_->debug_file(); }
+
+      using section_data = elf_image::section_data;
+      std::optional<const Elf64_Shdr*> get_section(std::string_view name) const { return image_->get_section(name); }
+      section_data get_section_data(std::string_view name) const { return image_->get_section_data(name); }
+      span<const std::byte> get_section_contents(std::string_view name) const {
+        return image_->get_section_contents(name);
+      }
+
+      void prefetch_compressed_sections() const { image_->prefetch_compressed_sections(); }
+      // Process-wide, see elf_image::set_decompression_cache_limit
+      static void set_decompression_cache_limit(std::size_t bytes) { elf_image::set_decompression_cache_limit(bytes); }
+      static std::size_t decompression_cache_limit() { return elf_image::decompression_cache_limit(); }
+
+      const Elf64_Shdr* get_section_containing_address(file_addr addr) const;
+      const Elf64_Shdr* get_section_containing_address(virt_addr addr) const;
+
+      span<const Elf64_Phdr> program_headers() const { return image_->program_headers(); }
+      const Elf64_Phdr* get_segment_containing_address(file_addr addr) const;
+
+      std::optional<std::uint64_t> get_file_offset(file_addr addr) const;
+      std::optional<file_addr> get_file_addr(std::uint64_t offset) const;
+
+      std::optional<span<const std::byte>> get_bytes(file_addr address, std::size_t size) const;
+
+      // Unlike the image, the load bias is per elf, so targets sharing a file can load it at different addresses
+      virt_addr load_bias() const { return load_bias_; }
+      void notify_loaded(virt_addr address) { load_bias_ = address; }
+
+      std::optional<file_addr> get_section_start_address(std::string_view name) const;
+
+      std::vector<const Elf64_Sym*> get_symbols_by_name(std::string_view name) const {
+        return image_->get_symbols_by_name(name);
+      }
+      std::optional<const Elf64_Sym*> get_symbol_at_address(file_addr address) const;
+      std::optional<const Elf64_Sym*> get_symbol_at_address(virt_addr address) const;
+      std::optional<const Elf64_Sym*> get_symbol_containing_address(file_addr address) const;
+      std::optional<const Elf64_Sym*> get_symbol_containing_address(virt_addr address) const;
+
+      // Like calling get_symbol_containing_address on each address, but without the
+      // per-address section lookup, and resolving ascending runs of addresses with
+      // a single merge over the symbols
+      std::vector<std::optional<const Elf64_Sym*>> symbolize(span<const virt_addr> addresses) const;
+
+    private:
+      std::shared_ptr<const elf_image> image_;
+      std::filesystem::path path_;
+      virt_addr load_bias_;
   };
 }
 
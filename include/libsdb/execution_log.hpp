@@ -0,0 +1,65 @@
+#ifndef SDB_EXECUTION_LOG_HPP
+#define SDB_EXECUTION_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/user.h>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  /*
+    Bounded log of single-stepped instructions, newest last, used to step backwards.
+    Each entry holds only what the instruction destroyed: the old values of the
+    register words that changed and the old contents of the memory it wrote.
+    Entries are packed into a fixed-size byte ring and the oldest are evicted
+    when it fills up, so a typical instruction costs around 30 bytes.
+  */
+  class execution_log {
+    public:
+      struct memory_write {
+        virt_addr address;
+        std::vector<std::byte> old_data;
+      };
+
+      explicit execution_log(std::size_t capacity);
+
+      execution_log(const execution_log&) = delete;
+      execution_log& operator=(const execution_log&) = delete;
+
+      void push(
+        const user_regs_struct& gprs_before, const user_fpregs_struct& fprs_before,
+        const user_regs_struct& gprs_after, const user_fpregs_struct& fprs_after,
+        const std::vector<memory_write>& writes);
+
+      // Removes the newest entry. gprs and fprs must hold the state after the
+      // instruction and are rolled back to the state before it; the memory
+      // writes that must be undone are returned.
+      std::vector<memory_write> pop(user_regs_struct& gprs, user_fpregs_struct& fprs);
+
+      bool empty() const { return n_entries_ == 0; }
+      std::size_t size() const { return n_entries_; }
+      std::size_t bytes_used() const { return used_; }
+      std::size_t capacity() const { return capacity_; }
+      void clear() { head_ = used_ = n_entries_ = 0; }
+
+    private:
+      // Every entry is framed by its total size at both ends,
+      // so the ring can be walked from the oldest or the newest entry
+      using size_field = std::uint32_t;
+
+      void write_bytes(std::size_t pos, const void* src, std::size_t size);
+      void read_bytes(std::size_t pos, void* dest, std::size_t size) const;
+      void evict_oldest();
+
+      std::unique_ptr<std::byte[]> data_;
+      std::size_t capacity_;
+      // Offset one past the newest entry
+      std::size_t head_ = 0;
+      std::size_t used_ = 0;
+      std::size_t n_entries_ = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SDB_INDEX_CACHE_HPP
+#define SDB_INDEX_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  /*
+    On-disk cache of indexes built from an object file, so they don't have to be
+    rebuilt every time the same binary is loaded. A cache file holds a set of
+    blobs identified by tag, each 8-byte aligned, and is mmapped so the blobs can
+    be used in place. Files live in $XDG_CACHE_HOME/sdb, or ~/.cache/sdb, and are
+    named by a key that should identify the object's contents, such as its build ID.
+
+    The cache is best effort: unreadable, stale or corrupt files are ignored.
+  */
+  class index_cache {
+    public:
+      // Bump whenever the layout of any blob changes
+      static constexpr std::uint32_t version = 1;
+
+      enum class tag : std::uint32_t {
+        symbol_starts, symbol_ends, symbols_by_start, start_tree, start_tree_index,
+        demangled_names, name_entries, name_buckets
+      };
+
+      // Returns the cache file for key, or nothing if there isn't a usable one
+      static std::unique_ptr<index_cache> load(std::string_view key);
+      ~index_cache();
+
+      index_cache(const index_cache&) = delete;
+      index_cache& operator=(const index_cache&) = delete;
+
+      std::optional<span<const std::byte>> get(tag id) const;
+
+      // Views a blob as an array of T, or nothing if it is missing or malformed
+      template <class T>
+      std::optional<span<const T>> get_array(tag id) const {
+        auto blob = get(id);
+        if (!blob or blob->size() % sizeof(T) != 0 or
+            reinterpret_cast<std::uintptr_t>(blob->begin()) % alignof(T) != 0) {
+          return std::nullopt;
+        }
+        return span<const T>{ reinterpret_cast<const T*>(blob->begin()), blob->size() / sizeof(T) };
+      }
+
+      static std::filesystem::path directory();
+
+      class writer {
+        public:
+          void add(tag id, span<const std::byte> data);
+
+          template <class T>
+          void add_array(tag id, span<const T> data) {
+            add(id, { reinterpret_cast<const std::byte*>(data.begin()), data.size() * sizeof(T) });
+          }
+
+          // Atomically replaces the cache file for key. Returns false if it couldn't be written.
+          bool commit(std::string_view key) const;
+
+        private:
+          std::vector<std::pair<tag, std::vector<std::byte>>> blobs_;
+      };
+
+    private:
+      index_cache(std::byte* data, std::size_t size) : data_(data), size_(size) {}
+
+      std::byte* data_;
+      std::size_t size_;
+  };
+}
+
+#endif
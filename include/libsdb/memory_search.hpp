@@ -0,0 +1,25 @@
+#ifndef SDB_MEMORY_SEARCH_HPP
+#define SDB_MEMORY_SEARCH_HPP
+
+#include <cstddef>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  struct address_range {
+    virt_addr start;
+    virt_addr end;
+  };
+
+  /*
+    Appends to out the offset of every occurrence of needle in haystack that starts
+    before search_end, so that callers scanning in overlapping chunks see each match once.
+    Candidates are found 32 or 16 bytes at a time by comparing the needle's first
+    and last bytes, using AVX2 where the CPU supports it and SSE2 otherwise.
+  */
+  void find_all(
+    span<const std::byte> haystack, span<const std::byte> needle,
+    std::size_t search_end, std::vector<std::size_t>& out);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SDB_MEMORY_SNAPSHOT_HPP
+#define SDB_MEMORY_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <libsdb/memory_search.hpp>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  class process;
+
+  /*
+    Copy of some ranges of a process's memory, taken so that it can later be
+    compared against the live contents. Memory is stored in page-sized blocks
+    that are deduplicated by content, and all-zero blocks are not stored at all,
+    so large mostly-untouched heaps and stacks are cheap to snapshot.
+  */
+  class memory_snapshot {
+    public:
+      struct change {
+        virt_addr address;
+        std::vector<std::byte> old_data;
+        std::vector<std::byte> new_data;
+      };
+
+      // Breakpoint bytes are hidden, as with read_memory_without_traps
+      static memory_snapshot take(const process& proc, const std::vector<address_range>& ranges);
+
+      // Returns the runs of bytes that differ between the snapshot and the live
+      // process, in address order. Throws if part of a range is no longer readable.
+      std::vector<change> diff(const process& proc) const;
+
+      const std::vector<address_range>& ranges() const { return ranges_; }
+      // Number of bytes the snapshot covers
+      std::size_t size() const;
+      // Number of bytes actually held after deduplication
+      std::size_t stored_bytes() const { return n_blocks_ * block_size; }
+
+      static constexpr std::size_t block_size = 0x1000;
+
+    private:
+      // Marks a block that is entirely zero and so has no storage
+      static constexpr std::uint32_t zero_block = UINT32_MAX;
+      static constexpr std::size_t blocks_per_slab = 256;
+
+      memory_snapshot() = default;
+
+      std::uint32_t store_block(const std::byte* data, std::size_t size);
+      const std::byte* block_data(std::uint32_t id) const;
+
+      std::vector<address_range> ranges_;
+      // One block id per block_size bytes of each range, with the last block of a range zero-padded
+      std::vector<std::vector<std::uint32_t>> block_ids_;
+
+      std::vector<std::unique_ptr<std::byte[]>> slabs_;
+      std::size_t n_blocks_ = 0;
+      std::unordered_multimap<std::uint64_t, std::uint32_t> blocks_by_hash_;
+  };
+}
+
+#endif
@@ -2,15 +2,21 @@
 #define SDB_PROCESS_HPP
 
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <sys/types.h>
 #include <optional>
+#include <string>
 #include <vector>
 #include <unordered_map>
 #include <libsdb/bit.hpp>
 #include <libsdb/registers.hpp>
 #include <libsdb/breakpoint_site.hpp>
+#include <libsdb/core_file.hpp>
+#include <libsdb/execution_log.hpp>
+#include <libsdb/memory_search.hpp>
 #include <libsdb/stoppoint_collection.hpp>
+#include <libsdb/syscall_log.hpp>
 #include <libsdb/watchpoint.hpp>
 
 namespace sdb {
@@ -23,6 +29,25 @@ namespace sdb {
     };
   };
 
+  struct memory_region {
+    virt_addr start;
+    virt_addr end;
+    bool readable;
+    bool writable;
+    bool executable;
+    bool shared;
+    std::uint64_t offset;
+    std::string path;
+    // Inode of the mapped file, or 0 for anonymous memory and core files
+    std::uint64_t inode = 0;
+  };
+
+  struct checkpoint {
+    int id;
+    pid_t pid;
+    virt_addr pc;
+  };
+
   enum class process_state {
     stopped,
     running,
@@ -48,6 +73,21 @@ namespace sdb {
     std::optional<syscall_information> syscall_info;
   };
 
+  struct launch_options {
+    // Arguments after argv[0], which is always the program path
+    std::vector<std::string> args;
+    // Replaces the environment if set; otherwise sdb's own environment is inherited
+    std::optional<std::vector<std::string>> env;
+    std::optional<std::filesystem::path> working_directory;
+
+    // Each redirection dup2s the sdb descriptor `from` onto `to` in the inferior
+    struct redirection {
+      int from;
+      int to;
+    };
+    std::vector<redirection> redirections;
+  };
+
   class syscall_catch_policy {
     public:
       enum mode {
@@ -84,7 +124,14 @@ namespace sdb {
                bool debug = true,
                std::optional<int> stdout_replacement = std::nullopt
          );
+        static std::unique_ptr<process> launch(
+               std::filesystem::path path,
+               const launch_options& options,
+               bool debug = true
+         );
         static std::unique_ptr<process> attach(pid_t pid);
+        // A stopped, read-only process whose memory and registers come from a core file
+        static std::unique_ptr<process> load_core(const std::filesystem::path& path);
         ~process();
 
         // Ensure a public constructor can't be used. Force the static methods for object creation
@@ -95,10 +142,18 @@ namespace sdb {
 
         void resume();
         stop_reason wait_on_signal();
+        void detach();
+
+        // Called with every stop seen by wait_on_signal. If it returns true the stop was
+        // only of interest to the debugger itself, such as an internal breakpoint, so the
+        // process is resumed and wait_on_signal keeps waiting.
+        using stop_handler = std::function<bool(const stop_reason&)>;
+        void set_stop_handler(stop_handler handler) { stop_handler_ = std::move(handler); }
 
         process_state state() const { return state_; }
 
         pid_t pid() const { return pid_; }
+        bool is_core() const { return core_ != nullptr; }
 
         registers& get_registers() { return *registers_; }
         const registers& get_registers() const { return *registers_; }
@@ -126,14 +181,35 @@ namespace sdb {
         std::vector<std::byte> read_memory_without_traps(virt_addr address, std::size_t amount) const;
         void write_memory(virt_addr address, span<const std::byte> data);
 
+        // Returns the address of every occurrence of pattern in readable memory, in ascending
+        // order. If ranges is empty the whole address space is searched. Breakpoint bytes are
+        // hidden from the search, and large mappings are split between worker threads.
+        std::vector<virt_addr> find(
+          span<const std::byte> pattern, const std::vector<address_range>& ranges = {}) const;
+
         int set_hardware_breakpoint(breakpoint_site::id_type id, virt_addr address);
         void clear_hardware_stoppoint(int index);
 
-        void set_syscall_catch_policy(syscall_catch_policy info) {
-          syscall_catch_policy_ = std::move(info);
-        }
+        void set_syscall_catch_policy(syscall_catch_policy info);
+
+        // While recording, the results of nondeterministic syscalls are appended to the log.
+        // While replaying, those syscalls are suppressed and their recorded results injected
+        // instead; replay stops with an error if the process makes a different syscall than
+        // the log expects. Calls served by the vDSO, such as most clock_gettime calls,
+        // never enter the kernel and so are neither recorded nor replayed.
+        void start_syscall_recording();
+        void start_syscall_replay(syscall_log log);
+        void stop_syscall_log() { syscall_log_mode_ = syscall_log_mode::off; }
+        syscall_log_mode get_syscall_log_mode() const { return syscall_log_mode_; }
+        const syscall_log& get_syscall_log() const { return syscall_log_; }
+        std::size_t syscall_replay_position() const { return replay_position_; }
 
         std::unordered_map<int, std::uint64_t> get_auxv() const;
+        std::vector<memory_region> get_memory_regions() const;
+
+        // Writes an ELF core file of the stopped process. Pages that are
+        // unreadable or entirely zero are left as holes in the output file.
+        void dump_core(const std::filesystem::path& path) const;
 
         template <class T>
         T read_memory_as(virt_addr address) const {
@@ -146,6 +222,35 @@ namespace sdb {
         stoppoint_collection<watchpoint>& watchpoints() { return watchpoints_; }
         const stoppoint_collection<watchpoint>& watchpoints() const { return watchpoints_; }
 
+        // Checkpoints are copy-on-write forks of the inferior, held stopped under ptrace.
+        // Restarting kills the current inferior and continues from a fresh fork of the
+        // checkpoint, so a checkpoint can be restarted any number of times. Processes
+        // that sdb attached to rather than launched can't be checkpointed.
+        int create_checkpoint();
+        void restart_checkpoint(int id);
+        void delete_checkpoint(int id);
+        const std::vector<checkpoint>& checkpoints() const { return checkpoints_; }
+
+        // Makes the stopped inferior run a syscall on the spot and returns its result,
+        // leaving its registers and code as they were. Pending signals are discarded.
+        std::int64_t inject_syscall(std::uint64_t number, const std::array<std::uint64_t, 6>& args = {});
+
+        // Forks the stopped inferior into a new traced process, stopped at the same point
+        // and killed when the returned object is destroyed. The clone starts with no stoppoints.
+        std::unique_ptr<process> clone_stopped();
+
+        // While recording, resuming single-steps the inferior and logs every instruction,
+        // so execution can be reversed back through the last capacity bytes of history.
+        // Memory written by the kernel isn't restored. Stepping never stops at syscalls, so
+        // recording can't be combined with syscall catchpoints or syscall record/replay.
+        void start_recording(std::size_t capacity = 256 * 1024 * 1024);
+        void stop_recording() { execution_log_.reset(); }
+        bool is_recording() const { return execution_log_ != nullptr; }
+        const execution_log* get_execution_log() const { return execution_log_.get(); }
+        stop_reason reverse_step_instruction();
+        // Reverses until an enabled breakpoint site or the start of the recording
+        stop_reason reverse_continue();
+
         void augment_stop_reason(stop_reason& reason);
         std::variant<breakpoint_site::id_type, watchpoint::id_type> get_current_hardware_stoppoint() const;
         
@@ -164,12 +269,32 @@ namespace sdb {
       process_state state_ = process_state::stopped;
       void read_all_registers();
       int set_hardware_stoppoint(virt_addr address, stoppoint_mode mode, std::size_t size);
-      sdb::stop_reason maybe_resume_from_syscall(const stop_reason& reason);
+      bool should_resume_from_syscall(const stop_reason& reason) const;
+      void handle_logged_syscall(stop_reason& reason);
+      void ensure_live() const;
+      void ensure_not_recording() const;
+      stop_reason wait_for_stop();
+      stop_reason single_step();
+      stop_reason record_step();
+      stop_reason record_until_stop();
+      void undo_recorded_step();
+      pid_t fork_without_breakpoints();
 
       std::unique_ptr<registers> registers_;
       stoppoint_collection<breakpoint_site> breakpoint_sites_;
       stoppoint_collection<watchpoint> watchpoints_;
       syscall_catch_policy syscall_catch_policy_ = syscall_catch_policy::catch_none();
+      syscall_log_mode syscall_log_mode_ = syscall_log_mode::off;
+      syscall_log syscall_log_;
+      std::size_t replay_position_ = 0;
+      syscall_information current_syscall_{};
+      std::uint64_t current_syscall_bound_ = 0;
+      bool replaying_current_syscall_ = false;
+      std::unique_ptr<core_file> core_;
+      std::vector<checkpoint> checkpoints_;
+      int next_checkpoint_id_ = 1;
+      std::unique_ptr<execution_log> execution_log_;
+      stop_handler stop_handler_;
   };
 }
 
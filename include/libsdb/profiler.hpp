@@ -0,0 +1,68 @@
+#ifndef SDB_PROFILER_HPP
+#define SDB_PROFILER_HPP
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  class process;
+  class elf;
+
+  /*
+    Sampling profiler built on perf_event_open. Samples are taken by the kernel
+    on a PERF_COUNT_SW_CPU_CLOCK timer (so it also works in VMs without PMUs) and
+    are written into mmapped ring buffers, meaning the profiled process never
+    enters a ptrace stop while it is being sampled.
+  */
+  class profiler {
+    public:
+      profiler(process& proc, std::uint64_t frequency = 999, std::size_t buffer_pages = 64);
+      ~profiler();
+
+      profiler() = delete;
+      profiler(const profiler&) = delete;
+      profiler& operator=(const profiler&) = delete;
+
+      void enable();
+      void disable();
+
+      // Waits up to timeout_ms for samples and drains the ring buffer.
+      // Returns false once the profiled process has gone away.
+      bool poll(int timeout_ms);
+      void drain();
+
+      std::uint64_t sample_count() const { return sample_count_; }
+      std::uint64_t lost_count() const { return lost_count_; }
+
+      // Callchains are stored leaf first, keyed by the raw return addresses
+      const std::map<std::vector<std::uint64_t>, std::uint64_t>& stacks() const { return stacks_; }
+
+      // Writes one "root;caller;leaf count" line per unique symbolized stack,
+      // which is the input format expected by flamegraph.pl and friends
+      void write_folded_stacks(std::ostream& out, const elf& obj) const;
+
+    private:
+      // One sampling event and ring buffer per CPU, since the kernel refuses
+      // to mmap per-task events that are inherited by new threads
+      struct ring {
+        int fd;
+        void* data;
+      };
+
+      void drain(ring& buffer);
+      void handle_record(const std::byte* record);
+
+      std::vector<ring> rings_;
+      std::size_t ring_size_ = 0;
+      std::size_t data_size_ = 0;
+
+      std::uint64_t sample_count_ = 0;
+      std::uint64_t lost_count_ = 0;
+      std::map<std::vector<std::uint64_t>, std::uint64_t> stacks_;
+  };
+}
+
+#endif
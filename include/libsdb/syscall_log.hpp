@@ -0,0 +1,67 @@
+#ifndef SDB_SYSCALL_LOG_HPP
+#define SDB_SYSCALL_LOG_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <libsdb/types.hpp>
+
+namespace sdb {
+  class process;
+
+  enum class syscall_log_mode {
+    off, record, replay
+  };
+
+  /*
+    Results of the nondeterministic syscalls made by a process, in the order
+    they were made: the return value plus the contents of every output buffer
+    the kernel filled in. Outputs are stored by position rather than address,
+    so a replay writes them to wherever the replaying process passed its buffers.
+  */
+  class syscall_log {
+    public:
+      struct entry {
+        std::uint16_t id;
+        std::int64_t ret;
+        std::vector<std::vector<std::byte>> outputs;
+      };
+
+      static syscall_log load(const std::filesystem::path& path);
+      void save(const std::filesystem::path& path) const;
+
+      // Whether results of this syscall are recorded and replayed
+      static bool is_logged(std::uint16_t id);
+
+      // The size the caller passed in for an output the kernel also reports the size of
+      // through the same memory, such as recvfrom's *addrlen. Must be read at syscall entry,
+      // since the kernel replaces it with the full size even if that didn't fit.
+      static std::uint64_t entry_bound(const process& proc, std::uint16_t id, const std::array<std::uint64_t, 6>& args);
+
+      // The buffers a logged syscall writes its results to, given its entry
+      // arguments, entry_bound and return value. Null buffers are left out.
+      struct output_range {
+        virt_addr address;
+        std::size_t size;
+      };
+      static std::vector<output_range> output_ranges(
+        const process& proc, std::uint16_t id,
+        const std::array<std::uint64_t, 6>& args, std::uint64_t entry_bound, std::int64_t ret);
+
+      // Upper bound of output_ranges for when the syscall has not returned yet
+      static std::vector<output_range> max_output_ranges(
+        const process& proc, std::uint16_t id, const std::array<std::uint64_t, 6>& args);
+
+      void push(entry e) { entries_.push_back(std::move(e)); }
+      const std::vector<entry>& entries() const { return entries_; }
+      std::size_t size() const { return entries_.size(); }
+      bool empty() const { return entries_.empty(); }
+
+    private:
+      std::vector<entry> entries_;
+  };
+}
+
+#endif
@@ -1,11 +1,24 @@
-#ifndef SDB_TARGET_HP
-#define SDB_TARGET_HPPP
+#ifndef SDB_TARGET_HPP
+#define SDB_TARGET_HPP
 
 #include<memory>
 #include<libsdb/elf.hpp>
 #include<libsdb/process.hpp>
 
 namespace sdb {
+  /*
+    A shared library loaded into the process, as reported by the dynamic linker.
+    The library's elf is only opened the first time something needs it.
+  */
+  struct loaded_module {
+    std::filesystem::path path;
+    virt_addr load_bias;
+    // The span of the library's loadable segments, or empty if it couldn't be read
+    virt_addr start;
+    virt_addr end;
+    mutable std::unique_ptr<elf> obj;
+  };
+
   class target {
     public:
       target() = delete;
@@ -13,7 +26,12 @@ namespace sdb {
       target& operator=(const target&) = delete;
 
       static std::unique_ptr<target> launch(std::filesystem::path path, std::optional<int> stdout_replacement = std::nullopt);
+      static std::unique_ptr<target> launch(std::filesystem::path path, const launch_options& options);
       static std::unique_ptr<target> attach(pid_t pid);
+      static std::unique_ptr<target> load_core(const std::filesystem::path& core, const std::filesystem::path& exe);
+
+      // A new target for a fork of this one's stopped process; see process::clone_stopped
+      std::unique_ptr<target> clone_stopped();
 
       process& get_process() { return *process_; }
       elf& get_elf() { return *elf_; }
@@ -21,12 +39,39 @@ namespace sdb {
       const process& get_process() const { return *process_; }
       const elf& get_elf() const { return *elf_; }
 
+      // Shared libraries in address order. Kept up to date by stopping at the dynamic
+      // linker's r_brk hook whenever libraries are loaded or unloaded.
+      const std::vector<loaded_module>& get_modules() const { return modules_; }
+
+      // The main executable, loaded library or vDSO that contains address, if any
+      const elf* get_elf_containing_address(virt_addr address) const;
+
+      // The vDSO has no file, so it is parsed from a copy read out of the process's
+      // memory the first time it's needed and kept from then on
+      const elf* get_vdso() const;
+
     private:
-      target(std::unique_ptr<process> proc, std::unique_ptr<elf> obj)
-        : process_(std::move(proc)), elf_(std::move(obj)) {}
+      target(std::unique_ptr<process> proc, std::unique_ptr<elf> obj);
+
+      bool notify_stop(const stop_reason& reason);
+      void resolve_dynamic_linker();
+      std::optional<virt_addr> read_rendezvous_address() const;
+      void reload_modules();
+      // Where to open a library from, which is its mapping rather than its path
+      // if the file was deleted or replaced after it was loaded
+      std::filesystem::path module_file(const loaded_module& module) const;
 
       std::unique_ptr<process> process_;
       std::unique_ptr<elf> elf_;
+
+      // Address of the dynamic linker's r_debug structure, and its hook that is called
+      // around every change to the link map
+      std::optional<virt_addr> rendezvous_address_;
+      std::optional<virt_addr> rendezvous_breakpoint_;
+      std::vector<loaded_module> modules_;
+
+      mutable bool vdso_loaded_ = false;
+      mutable std::unique_ptr<elf> vdso_;
   };
 }
 
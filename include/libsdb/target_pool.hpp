@@ -0,0 +1,34 @@
+#ifndef SDB_TARGET_POOL_HPP
+#define SDB_TARGET_POOL_HPP
+
+#include <filesystem>
+#include <memory>
+#include <libsdb/process.hpp>
+#include <libsdb/target.hpp>
+
+namespace sdb {
+  /*
+    Fork server for launching many short-lived targets of the same program.
+    The program is launched once and run to its entry point, past the
+    dynamic loader; each acquire() then forks that template instead of
+    exec'ing again. Acquired targets start at the entry point rather than
+    at the loader's first instruction, and all of them share the pool's
+    arguments, environment and redirections.
+  */
+  class target_pool {
+    public:
+      explicit target_pool(std::filesystem::path path, const launch_options& options = {});
+
+      target_pool(const target_pool&) = delete;
+      target_pool& operator=(const target_pool&) = delete;
+
+      std::unique_ptr<target> acquire();
+
+      const target& get_template() const { return *template_; }
+
+    private:
+      std::unique_ptr<target> template_;
+  };
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/procfs.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libsdb/bit.hpp>
+#include <libsdb/core_file.hpp>
+#include <libsdb/error.hpp>
+
+sdb::core_file::core_file(const std::filesystem::path& path) : path_(path) {
+  if ((fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+    error::send_errno("Could not open core file");
+  }
+
+  struct stat stats;
+  if (fstat(fd_, &stats) < 0) {
+    close(fd_);
+    error::send_errno("Could not retrieve core file stats");
+  }
+  file_size_ = stats.st_size;
+
+  void* ret;
+  if ((ret = mmap(0, file_size_, PROT_READ, MAP_SHARED, fd_, 0)) == MAP_FAILED) {
+    close(fd_);
+    error::send_errno("Could not mmap core file");
+  }
+  data_ = reinterpret_cast<std::byte*>(ret);
+
+  auto fail = [this](const std::string& message) {
+    munmap(data_, file_size_);
+    close(fd_);
+    error::send(message);
+  };
+
+  if (file_size_ < sizeof(Elf64_Ehdr)) fail("Core file is truncated");
+  auto header = from_bytes<Elf64_Ehdr>(data_);
+  if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 or header.e_type != ET_CORE) {
+    fail("Not an ELF core file");
+  }
+  if (header.e_phoff + header.e_phnum * sizeof(Elf64_Phdr) > file_size_) {
+    fail("Core file program headers are truncated");
+  }
+
+  for (auto i = 0; i < header.e_phnum; ++i) {
+    auto phdr = from_bytes<Elf64_Phdr>(data_ + header.e_phoff + i * sizeof(Elf64_Phdr));
+
+    if (phdr.p_type == PT_NOTE) {
+      parse_notes(phdr);
+    } else if (phdr.p_type == PT_LOAD) {
+      // Segments may be cut short if the core was truncated while being written
+      auto file_size = std::min<std::uint64_t>(phdr.p_filesz, file_size_ - std::min<std::uint64_t>(phdr.p_offset, file_size_));
+      segments_.push_back({
+        virt_addr{ phdr.p_vaddr }, virt_addr{ phdr.p_vaddr + phdr.p_memsz },
+        phdr.p_offset, file_size, phdr.p_flags
+      });
+    }
+  }
+
+  std::sort(begin(segments_), end(segments_), [](auto& lhs, auto& rhs) {
+    return lhs.start < rhs.start;
+  });
+}
+
+sdb::core_file::~core_file() {
+  munmap(data_, file_size_);
+  close(fd_);
+}
+
+void sdb::core_file::parse_notes(const Elf64_Phdr& phdr) {
+  auto align4 = [](std::size_t n) { return (n + 3) & ~std::size_t(3); };
+
+  // Notes lost when a core was truncated are skipped like the rest of the missing data
+  if (phdr.p_offset >= file_size_) return;
+
+  auto pos = data_ + phdr.p_offset;
+  auto end = pos + std::min<std::uint64_t>(phdr.p_filesz, file_size_ - phdr.p_offset);
+  bool seen_prstatus = false;
+
+  while (pos < end and static_cast<std::size_t>(end - pos) >= sizeof(Elf64_Nhdr)) {
+    auto note = from_bytes<Elf64_Nhdr>(pos);
+    // Sizes are compared rather than pointers so that huge sizes can't wrap past the mapping
+    auto desc_offset = sizeof(Elf64_Nhdr) + align4(note.n_namesz);
+    if (desc_offset + note.n_descsz > static_cast<std::size_t>(end - pos)) break;
+    auto desc = pos + desc_offset;
+
+    // Only the first NT_PRSTATUS is used; it belongs to the thread that was dumped first
+    if (note.n_type == NT_PRSTATUS and !seen_prstatus and note.n_descsz >= sizeof(elf_prstatus)) {
+      auto status = from_bytes<elf_prstatus>(desc);
+      pid_ = status.pr_pid;
+      signal_ = status.pr_cursig;
+      std::memcpy(&gprs_, &status.pr_reg, sizeof(gprs_));
+      seen_prstatus = true;
+    } else if (note.n_type == NT_FPREGSET and note.n_descsz >= sizeof(fprs_)) {
+      fprs_ = from_bytes<user_fpregs_struct>(desc);
+    } else if (note.n_type == NT_AUXV) {
+      for (std::size_t i = 0; i + 16 <= note.n_descsz; i += 16) {
+        auto id = from_bytes<std::uint64_t>(desc + i);
+        if (id == AT_NULL) break;
+        auxv_[id] = from_bytes<std::uint64_t>(desc + i + 8);
+      }
+    }
+
+    pos = desc + align4(note.n_descsz);
+  }
+}
+
+const sdb::core_file::segment* sdb::core_file::segment_containing(virt_addr address) const {
+  auto it = std::upper_bound(begin(segments_), end(segments_), address, [](auto addr, auto& seg) {
+    return addr < seg.start;
+  });
+  if (it == begin(segments_)) return nullptr;
+
+  --it;
+  return address < it->end ? &*it : nullptr;
+}
+
+std::optional<sdb::span<const std::byte>> sdb::core_file::view(virt_addr address, std::size_t size) const {
+  auto seg = segment_containing(address);
+  if (!seg) return std::nullopt;
+
+  auto offset = address.addr() - seg->start.addr();
+  if (offset + size > seg->file_size) return std::nullopt;
+
+  return span<const std::byte>{ data_ + seg->offset + offset, size };
+}
+
+std::vector<std::byte> sdb::core_file::read_memory(virt_addr address, std::size_t size) const {
+  std::vector<std::byte> ret(size);
+
+  std::size_t done = 0;
+  while (done < size) {
+    auto seg = segment_containing(address + done);
+    auto offset = seg ? (address + done).addr() - seg->start.addr() : 0;
+    if (!seg or offset >= seg->file_size) {
+      error::send("Could not read process memory: address not saved in core file");
+    }
+
+    auto amount = std::min<std::uint64_t>(size - done, seg->file_size - offset);
+    std::copy_n(data_ + seg->offset + offset, amount, ret.data() + done);
+    done += amount;
+  }
+
+  return ret;
+}
@@ -1,32 +1,135 @@
 #include <Zydis/Zydis.h>
 #include <libsdb/disassembler.hpp>
+#include <libsdb/error.hpp>
+#include <libsdb/syscall_log.hpp>
+
+namespace {
+  template <class Instruction>
+  std::vector<Instruction> decode(
+    const std::byte* code, std::size_t size, sdb::virt_addr address, std::size_t n_instructions) {
+    std::vector<Instruction> ret;
+    ret.reserve(n_instructions);
+
+    ZyanUSize offset = 0;
+    ZydisDisassembledInstruction instr;
+
+    while (n_instructions > 0 and ZYAN_SUCCESS(ZydisDisassembleATT(
+      ZYDIS_MACHINE_MODE_LONG_64, address.addr(),
+      code + offset, size - offset, &instr)))
+    {
+      ret.push_back(Instruction{ address, std::string(instr.text) });
+      offset += instr.info.length;
+      address += instr.info.length;
+      --n_instructions;
+    }
+
+    return ret;
+  }
+
+  std::uint64_t read_zydis_register(const sdb::process& proc, ZydisRegister reg) {
+    if (reg == ZYDIS_REGISTER_NONE) return 0;
+
+    auto& regs = proc.get_registers();
+    auto name = ZydisRegisterGetString(reg);
+    auto& info = sdb::register_info_by_name(name);
+    return std::visit([](auto v) -> std::uint64_t {
+      if constexpr (std::is_integral_v<decltype(v)>) {
+        return static_cast<std::uint64_t>(v);
+      } else {
+        sdb::error::send("Unexpected address register type");
+      }
+    }, regs.read(info));
+  }
+}
 
 std::vector<sdb::disassembler::instruction> sdb::disassembler::disassemble(
   std::size_t n_instructions,
   std::optional<virt_addr> address
 ) {
-  std::vector<instruction> ret;
-  ret.reserve(n_instructions);
-
   if (!address) {
     address.emplace(process_->get_pc());
   }
 
   // The largest x64 instruction size is 15 bytes
   auto code = process_->read_memory_without_traps(*address, n_instructions * 15);
+  return decode<instruction>(code.data(), code.size(), *address, n_instructions);
+}
+
+std::vector<sdb::disassembler::instruction> sdb::disassembler::disassemble(
+  const elf& obj, file_addr address, std::size_t n_instructions
+) {
+  auto segment = obj.get_segment_containing_address(address);
+  auto offset = obj.get_file_offset(address);
+  if (!segment or !offset) error::send("Address is not in the file contents of a segment");
+
+  // Stop at the end of the segment's file contents rather than requiring all 15 bytes per instruction
+  auto available = segment->p_vaddr + segment->p_filesz - address.addr();
+  auto code = obj.get_bytes(address, std::min<std::uint64_t>(available, n_instructions * 15));
+  if (!code) error::send("Segment contents are truncated");
+
+  return decode<instruction>(code->begin(), code->size(), virt_addr{ address.addr() + obj.load_bias().addr() }, n_instructions);
+}
+
+std::vector<sdb::disassembler::memory_range> sdb::disassembler::memory_writes() {
+  auto pc = process_->get_pc();
+  auto code = process_->read_memory_without_traps(pc, 15);
+
+  ZydisDecoder decoder;
+  ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+
+  ZydisDecodedInstruction instr;
+  ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+  if (!ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, code.data(), code.size(), &instr, operands))) {
+    error::send("Could not decode instruction");
+  }
+
+  std::vector<memory_range> ret;
+  auto& regs = process_->get_registers();
+
+  // The kernel writes syscall outputs; bound them by the buffer sizes passed in
+  if (instr.mnemonic == ZYDIS_MNEMONIC_SYSCALL) {
+    std::array<std::uint64_t, 6> args = {
+      regs.read_by_id_as<std::uint64_t>(register_id::rdi), regs.read_by_id_as<std::uint64_t>(register_id::rsi),
+      regs.read_by_id_as<std::uint64_t>(register_id::rdx), regs.read_by_id_as<std::uint64_t>(register_id::r10),
+      regs.read_by_id_as<std::uint64_t>(register_id::r8), regs.read_by_id_as<std::uint64_t>(register_id::r9),
+    };
+    auto id = regs.read_by_id_as<std::uint64_t>(register_id::rax);
+    for (auto& range : syscall_log::max_output_ranges(*process_, id, args)) {
+      ret.push_back({ range.address, range.size });
+    }
+    return ret;
+  }
+
+  for (auto i = 0; i < instr.operand_count; ++i) {
+    auto& op = operands[i];
+    if (op.type != ZYDIS_OPERAND_TYPE_MEMORY or op.mem.type != ZYDIS_MEMOP_TYPE_MEM or
+        !(op.actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) or op.size == 0) {
+      continue;
+    }
+
+    std::uint64_t address = op.mem.disp.value;
+    if (op.mem.base == ZYDIS_REGISTER_RIP) {
+      address += pc.addr() + instr.length;
+    } else {
+      address += read_zydis_register(*process_, op.mem.base);
+    }
+    address += read_zydis_register(*process_, op.mem.index) * op.mem.scale;
+
+    if (op.mem.segment == ZYDIS_REGISTER_FS) {
+      address += regs.read_by_id_as<std::uint64_t>(register_id::fs_base);
+    } else if (op.mem.segment == ZYDIS_REGISTER_GS) {
+      address += regs.read_by_id_as<std::uint64_t>(register_id::gs_base);
+    }
+
+    std::size_t size = op.size / 8;
+    // Implicit stack operands (push, call, enter) may be reported at either the old or new
+    // stack pointer, so cover the slots on both sides of it
+    if (op.visibility == ZYDIS_OPERAND_VISIBILITY_HIDDEN and op.mem.base == ZYDIS_REGISTER_RSP) {
+      address -= size;
+      size *= 2;
+    }
 
-  ZyanUSize offset = 0;
-  ZydisDisassembledInstruction instr;
-
-  while (ZYAN_SUCCESS(ZydisDisassembleATT(
-    ZYDIS_MACHINE_MODE_LONG_64, address->addr(),
-    code.data() + offset, code.size() - offset, &instr))
-    and n_instructions > 0)
-  {
-    ret.push_back(instruction{ *address, std::string(instr.text) });
-    offset += instr.info.length;
-    *address += instr.info.length;
-    --n_instructions;  
+    ret.push_back({ virt_addr{ address }, size });
   }
 
   return ret;
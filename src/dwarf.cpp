@@ -5,7 +5,12 @@
 #include <libsdb/error.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <set>
 #include <string_view>
+#include <thread>
 
 
 namespace {
@@ -98,6 +103,8 @@ namespace {
             pos_ += 4; break;
 
           case DW_FORM_data8:
+          case DW_FORM_ref8:
+          case DW_FORM_ref_sig8:
           case DW_FORM_addr:
             pos_ += 8; break;
 
@@ -140,35 +147,68 @@ namespace {
       const std::byte* pos_;
   };
 
-  sdb::die parse_die(const sdb::compile_unit& cu, cursor cur) {
-    auto pos = cur.position();
+  // Size of a form in DWARF32 with 8-byte addresses, if it doesn't depend on the data
+  std::optional<std::uint32_t> fixed_form_size(std::uint64_t form) {
+    switch (form) {
+      case DW_FORM_flag_present:
+        return 0;
+      case DW_FORM_data1:
+      case DW_FORM_ref1:
+      case DW_FORM_flag:
+        return 1;
+      case DW_FORM_data2:
+      case DW_FORM_ref2:
+        return 2;
+      case DW_FORM_data4:
+      case DW_FORM_ref4:
+      case DW_FORM_ref_addr:
+      case DW_FORM_sec_offset:
+      case DW_FORM_strp:
+        return 4;
+      case DW_FORM_data8:
+      case DW_FORM_ref8:
+      case DW_FORM_ref_sig8:
+      case DW_FORM_addr:
+        return 8;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  // Reads the DIE at position, which must be within the unit
+  sdb::die parse_die(const sdb::compile_unit& cu, const std::byte* position) {
+    cursor cur({ position, cu.data().end() });
     auto abbrev_code = cur.uleb128();
 
-    // If the DIE is null, this marks the end of the compile unit
+    // A null DIE marks the end of a list of siblings
     if (abbrev_code == 0) {
       auto next = cur.position();
       return sdb::die{ next };
     }
 
-    auto& abbrev_table = cu.abbrev_table();
-    auto& abbrev = abbrev_table.at(abbrev_code);
-
-    std::vector<const std::byte*> attr_locs;
-    attr_locs.reserve(abbrev.attr_specs.size());
-    for (auto& attr : abbrev.attr_specs) {
-      attr_locs.push_back(cur.position());
-      cur.skip_form(attr.form);
+    auto& abbrev = cu.abbrev_table().at(abbrev_code);
+    auto attrs = cur.position();
+
+    if (abbrev.fixed_size) {
+      cur += *abbrev.fixed_size;
+    } else {
+      // Only the attributes from the first variable-size one on need to be decoded
+      auto first = abbrev.fixed_offsets.size() - 1;
+      cur += abbrev.fixed_offsets[first];
+      for (auto i = first; i < abbrev.attr_specs.size(); ++i) {
+        cur.skip_form(abbrev.attr_specs[i].form);
+      }
     }
 
-    auto next = cur.position();
-    return sdb::die(pos, &cu, &abbrev, std::move(attr_locs), next);
+    return sdb::die(position, &cu, &abbrev, attrs, cur.position());
   }
 
-  std::unordered_map<std::uint64_t, sdb::abbrev> parse_abbrev_table(const sdb::elf& obj, std::size_t offset) {
-    cursor cur(obj.get_section_contents(".debug_abbrev"));
+  sdb::abbrev_table parse_abbrev_table(sdb::span<const std::byte> debug_abbrev, std::size_t offset) {
+    if (offset >= debug_abbrev.size()) sdb::error::send("Abbreviation table offset is out of range");
+    cursor cur(debug_abbrev);
     cur += offset;
 
-    std::unordered_map<std::uint64_t, sdb::abbrev> table;
+    sdb::abbrev_table table;
     std::uint64_t code = 0;
     do {
       code = cur.uleb128();
@@ -189,7 +229,22 @@ namespace {
       } while (attr != 0);
 
       if (code != 0) {
-        table.emplace(code, sdb::abbrev{ code, tag, has_children, std::move(attr_specs) });
+        sdb::abbrev entry{ code, tag, has_children, std::move(attr_specs), {}, std::nullopt };
+
+        std::uint32_t offset = 0;
+        bool all_fixed = true;
+        for (auto& spec : entry.attr_specs) {
+          entry.fixed_offsets.push_back(offset);
+          auto size = fixed_form_size(spec.form);
+          if (!size) {
+            all_fixed = false;
+            break;
+          }
+          offset += *size;
+        }
+        if (all_fixed) entry.fixed_size = offset;
+
+        table.add(std::move(entry));
       }
     } while (code != 0);
 
@@ -219,8 +274,8 @@ namespace {
     return std::make_unique<sdb::compile_unit>(dwarf, data, abbrev);
   }
 
-  std::vector<std::unique_ptr<sdb::compile_unit>> parse_compile_units(sdb::dwarf& dwarf, const sdb::elf& obj) {
-    auto debug_info = obj.get_section_contents(".debug_info");
+  std::vector<std::unique_ptr<sdb::compile_unit>> parse_compile_units(
+    sdb::dwarf& dwarf, const sdb::elf& obj, sdb::span<const std::byte> debug_info) {
     cursor cur(debug_info);
 
     std::vector<std::unique_ptr<sdb::compile_unit>> units;
@@ -233,26 +288,469 @@ namespace {
     return units;
   }
 
-}
+  /*
+    Runs f(task, worker) for every task in [0, n_tasks) on up to n_threads threads, with
+    the calling thread as worker 0. The first exception thrown by any task is rethrown
+    once every thread has finished.
+  */
+  template <class F>
+  void parallel_for(std::size_t n_tasks, std::size_t n_threads, F f) {
+    std::atomic<std::size_t> next_task = 0;
+    std::exception_ptr failure;
+    std::mutex failure_mutex;
+
+    auto worker = [&](std::size_t id) {
+      try {
+        for (auto i = next_task++; i < n_tasks; i = next_task++) {
+          f(i, id);
+        }
+      } catch (...) {
+        std::lock_guard lock(failure_mutex);
+        if (!failure) failure = std::current_exception();
+        // Stop the other workers from starting new tasks
+        next_task = n_tasks;
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < n_threads; ++i) {
+      workers.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : workers) {
+      thread.join();
+    }
 
-const std::unordered_map<std::uint64_t, sdb::abbrev>& sdb::dwarf::get_abbrev_table(std::size_t offset) {
-  if (!abbrev_tables_.count(offset)) {
-    abbrev_tables_.emplace(offset, parse_abbrev_table(*elf_, offset));
+    if (failure) std::rethrow_exception(failure);
   }
 
-  return abbrev_tables_.at(offset);
+  std::size_t worker_count(std::size_t requested, std::size_t n_tasks) {
+    auto n = requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<std::size_t>(1, std::min(n, n_tasks));
+  }
 }
 
-const std::unordered_map<std::uint64_t, sdb::abbrev>& sdb::compile_unit::abbrev_table() const {
-  return parent_->get_abbrev_table(abbrev_offset_);
+const sdb::abbrev& sdb::abbrev_table::at(std::uint64_t code) const {
+  auto entry = find(code);
+  if (!entry) sdb::error::send("Unknown abbreviation code");
+  return *entry;
+}
+
+void sdb::abbrev_table::add(abbrev entry) {
+  auto code = entry.code;
+  if (find(code)) sdb::error::send("Duplicate abbreviation code");
+
+  // Allow some slack so that tables numbered from a little above 1 stay dense
+  if (code <= 2 * (size_ + 1) + 64) {
+    if (code > dense_.size()) dense_.resize(code);
+    dense_[code - 1] = std::move(entry);
+  } else {
+    sparse_.emplace(code, std::move(entry));
+  }
+  ++size_;
+}
+
+const sdb::abbrev_table& sdb::dwarf::get_abbrev_table(std::size_t offset) const {
+  auto it = abbrev_tables_.find(offset);
+  if (it == end(abbrev_tables_)) sdb::error::send("No abbreviation table at offset");
+  return it->second;
 }
 
 sdb::dwarf::dwarf(const sdb::elf& parent) : elf_(&parent) {
-  compile_units_ = parse_compile_units(*this, parent);
+  debug_info_ = parent.get_section_data(".debug_info");
+  debug_str_ = parent.get_section_data(".debug_str");
+  compile_units_ = parse_compile_units(*this, parent, debug_info_.bytes);
+
+  /*
+    Units usually each have their own table, so parsing them is spread over the cores like
+    the units themselves. Parsing them all now means nothing mutates the map afterwards and
+    units can be read from any thread without locking.
+  */
+  std::vector<std::size_t> offsets;
+  {
+    std::set<std::size_t> distinct;
+    for (auto& unit : compile_units_) distinct.insert(unit->abbrev_offset());
+    offsets.assign(begin(distinct), end(distinct));
+  }
+
+  auto debug_abbrev = parent.get_section_data(".debug_abbrev");
+  std::vector<abbrev_table> tables(offsets.size());
+  parallel_for(offsets.size(), worker_count(0, offsets.size()), [&](std::size_t i, std::size_t) {
+    tables[i] = parse_abbrev_table(debug_abbrev.bytes, offsets[i]);
+  });
+  for (std::size_t i = 0; i < offsets.size(); ++i) {
+    abbrev_tables_.emplace(offsets[i], std::move(tables[i]));
+  }
+  for (auto& unit : compile_units_) {
+    unit->abbrev_table_ = &abbrev_tables_.at(unit->abbrev_offset());
+  }
+}
+
+const sdb::dwarf_index& sdb::dwarf::index() const {
+  std::call_once(index_built_, [this] { index_ = std::make_unique<dwarf_index>(*this); });
+  return *index_;
+}
+
+const sdb::compile_unit* sdb::dwarf::compile_unit_containing(const std::byte* position) const {
+  auto it = std::upper_bound(begin(compile_units_), end(compile_units_), position, [](auto pos, auto& unit) {
+    return pos < unit->data().begin();
+  });
+  if (it == begin(compile_units_)) return nullptr;
+
+  --it;
+  return position < (*it)->data().end() ? it->get() : nullptr;
 }
 
 sdb::die sdb::compile_unit::root() const {
   std::size_t header_size = 11; // size oif compile unit
-  cursor cur({ data_.begin() + header_size, data_.end() });
-  return parse_die(*this, cur);
+  return parse_die(*this, data_.begin() + header_size);
+}
+
+const std::byte* sdb::die::attr_location(std::size_t index) const {
+  auto& offsets = abbrev_->fixed_offsets;
+  if (index < offsets.size()) return attrs_ + offsets[index];
+
+  auto last = offsets.size() - 1;
+  cursor cur({ attrs_ + offsets[last], next_ });
+  for (auto i = last; i < index; ++i) {
+    cur.skip_form(abbrev_->attr_specs[i].form);
+  }
+  return cur.position();
+}
+
+bool sdb::die::contains(std::uint64_t attribute) const {
+  auto& specs = abbrev_->attr_specs;
+  return std::any_of(begin(specs), end(specs), [=](auto& spec) { return spec.attr == attribute; });
+}
+
+sdb::attr sdb::die::operator[](std::uint64_t attribute) const {
+  auto& specs = abbrev_->attr_specs;
+  for (std::size_t i = 0; i < specs.size(); ++i) {
+    if (specs[i].attr != attribute) continue;
+
+    auto location = attr_location(i);
+    auto form = specs[i].form;
+    // The real form is stored in front of the value
+    if (form == DW_FORM_indirect) {
+      cursor cur({ location, next_ });
+      form = cur.uleb128();
+      location = cur.position();
+    }
+    return { cu_, attribute, form, location };
+  }
+
+  sdb::error::send("Attribute not found");
+}
+
+const std::byte* sdb::die::sibling_position() const {
+  if (!abbrev_->has_children) return next_;
+  if (contains(DW_AT_sibling)) return (*this)[DW_AT_sibling].as_reference().position();
+
+  // Each child skips its own descendants the same way, ending at the null DIE closing the list
+  auto child = parse_die(*cu_, next_);
+  while (!child.is_null()) {
+    child = parse_die(*cu_, child.sibling_position());
+  }
+  return child.next();
+}
+
+sdb::die::children_range sdb::die::children() const {
+  return children_range{ *this };
+}
+
+sdb::die::children_range::iterator sdb::die::children_range::begin() const {
+  if (parent_.is_null() or !parent_.abbrev_->has_children) return end();
+  return iterator{ parse_die(*parent_.cu_, parent_.next_) };
+}
+
+sdb::die::children_range::iterator& sdb::die::children_range::iterator::operator++() {
+  die_ = parse_die(*die_->cu(), die_->sibling_position());
+  return *this;
+}
+
+bool sdb::die::children_range::iterator::operator==(const iterator& rhs) const {
+  auto lhs_end = !die_ or die_->is_null();
+  auto rhs_end = !rhs.die_ or rhs.die_->is_null();
+  if (lhs_end or rhs_end) return lhs_end == rhs_end;
+  return die_->position() == rhs.die_->position();
+}
+
+sdb::file_addr sdb::attr::as_address() const {
+  if (form_ != DW_FORM_addr) sdb::error::send("Invalid address type");
+
+  auto elf = cu_->dwarf_info()->elf_file();
+  return file_addr{ *elf, from_bytes<std::uint64_t>(location_) };
+}
+
+std::uint32_t sdb::attr::as_section_offset() const {
+  if (form_ != DW_FORM_sec_offset) sdb::error::send("Invalid offset type");
+  return from_bytes<std::uint32_t>(location_);
+}
+
+sdb::span<const std::byte> sdb::attr::as_block() const {
+  std::size_t size;
+  cursor cur({ location_, cu_->data().end() });
+  switch (form_) {
+    case DW_FORM_block1: size = cur.u8(); break;
+    case DW_FORM_block2: size = cur.u16(); break;
+    case DW_FORM_block4: size = cur.u32(); break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+      size = cur.uleb128(); break;
+    default: sdb::error::send("Invalid block type");
+  }
+  return { cur.position(), size };
+}
+
+std::uint64_t sdb::attr::as_int() const {
+  cursor cur({ location_, cu_->data().end() });
+  switch (form_) {
+    case DW_FORM_data1: return cur.u8();
+    case DW_FORM_data2: return cur.u16();
+    case DW_FORM_data4: return cur.u32();
+    case DW_FORM_data8: return cur.u64();
+    case DW_FORM_udata: return cur.uleb128();
+    case DW_FORM_sdata: return cur.sleb128();
+    default: sdb::error::send("Invalid integer type");
+  }
+}
+
+bool sdb::attr::as_flag() const {
+  switch (form_) {
+    case DW_FORM_flag_present: return true;
+    case DW_FORM_flag: return from_bytes<std::uint8_t>(location_) != 0;
+    default: sdb::error::send("Invalid flag type");
+  }
+}
+
+std::string_view sdb::attr::as_string() const {
+  cursor cur({ location_, cu_->data().end() });
+  switch (form_) {
+    case DW_FORM_string:
+      return cur.string();
+    case DW_FORM_strp: {
+      auto offset = cur.u32();
+      auto debug_str = cu_->dwarf_info()->debug_str();
+      if (offset >= debug_str.size()) sdb::error::send("String offset is out of range");
+      cursor str_cur({ debug_str.begin() + offset, debug_str.end() });
+      return str_cur.string();
+    }
+    default: sdb::error::send("Invalid string type");
+  }
+}
+
+sdb::die sdb::attr::as_reference() const {
+  cursor cur({ location_, cu_->data().end() });
+  std::size_t offset;
+  switch (form_) {
+    case DW_FORM_ref1: offset = cur.u8(); break;
+    case DW_FORM_ref2: offset = cur.u16(); break;
+    case DW_FORM_ref4: offset = cur.u32(); break;
+    case DW_FORM_ref8: offset = cur.u64(); break;
+    case DW_FORM_ref_udata: offset = cur.uleb128(); break;
+    case DW_FORM_ref_addr: {
+      // Relative to the start of .debug_info, so possibly in another unit
+      auto dwarf = cu_->dwarf_info();
+      auto debug_info = dwarf->debug_info();
+      offset = cur.u32();
+      auto unit = offset < debug_info.size() ? dwarf->compile_unit_containing(debug_info.begin() + offset) : nullptr;
+      if (!unit) sdb::error::send("Reference is outside of .debug_info");
+      return parse_die(*unit, debug_info.begin() + offset);
+    }
+    // Would need .debug_types, which DWARF 4 producers rarely emit
+    case DW_FORM_ref_sig8: sdb::error::send("Type unit references are not supported");
+    default: sdb::error::send("Invalid reference type");
+  }
+
+  if (offset >= cu_->data().size()) sdb::error::send("Reference is outside of its compile unit");
+  return parse_die(*cu_, cu_->data().begin() + offset);
+}
+
+namespace {
+  struct index_results {
+    std::vector<sdb::dwarf_index::named_die> functions;
+    std::vector<sdb::dwarf_index::named_die> variables;
+    std::vector<sdb::dwarf_index::named_die> types;
+    std::vector<sdb::dwarf_index::function_range> function_ranges;
+    std::size_t die_count = 0;
+    // Tags of the DIEs enclosing the current one, reused from unit to unit
+    std::vector<std::uint64_t> parents;
+  };
+
+  bool is_declaration(const sdb::die& entry) {
+    return entry.contains(DW_AT_declaration) and entry[DW_AT_declaration].as_flag();
+  }
+
+  // Out-of-line definitions and concrete instances take their name from the DIE they complete
+  std::optional<std::string_view> die_name(const sdb::die& entry) {
+    if (entry.contains(DW_AT_name)) return entry[DW_AT_name].as_string();
+    if (entry.contains(DW_AT_specification)) return die_name(entry[DW_AT_specification].as_reference());
+    if (entry.contains(DW_AT_abstract_origin)) return die_name(entry[DW_AT_abstract_origin].as_reference());
+    return std::nullopt;
+  }
+
+  void index_die(const sdb::die& entry, std::uint64_t parent_tag, index_results& results) {
+    switch (entry.tag()) {
+      case DW_TAG_subprogram: {
+        if (!entry.contains(DW_AT_low_pc)) return;
+
+        auto low = entry[DW_AT_low_pc].as_address().addr();
+        auto high = low;
+        if (entry.contains(DW_AT_high_pc)) {
+          auto high_pc = entry[DW_AT_high_pc];
+          // DWARF 4 producers usually give the size rather than the end address
+          high = high_pc.form() == DW_FORM_addr ? high_pc.as_address().addr() : low + high_pc.as_int();
+        }
+        results.function_ranges.push_back({ low, high, entry });
+
+        if (auto name = die_name(entry)) results.functions.push_back({ *name, entry });
+        return;
+      }
+      case DW_TAG_variable: {
+        if (parent_tag != DW_TAG_compile_unit and parent_tag != DW_TAG_namespace) return;
+        if (is_declaration(entry)) return;
+        if (auto name = die_name(entry)) results.variables.push_back({ *name, entry });
+        return;
+      }
+      case DW_TAG_base_type:
+      case DW_TAG_structure_type:
+      case DW_TAG_class_type:
+      case DW_TAG_union_type:
+      case DW_TAG_enumeration_type:
+      case DW_TAG_typedef: {
+        if (!entry.contains(DW_AT_name) or is_declaration(entry)) return;
+        results.types.push_back({ entry[DW_AT_name].as_string(), entry });
+        return;
+      }
+      default:
+        return;
+    }
+  }
+
+  // A linear pass over the unit, which is cheaper than following children ranges
+  void index_compile_unit(const sdb::compile_unit& cu, index_results& results) {
+    results.parents.clear();
+
+    auto pos = cu.root().position();
+    auto end = cu.data().end();
+    while (pos < end) {
+      auto entry = parse_die(cu, pos);
+      pos = entry.next();
+
+      if (entry.is_null()) {
+        // Units may be padded with null entries past the end of the root's children
+        if (!results.parents.empty()) results.parents.pop_back();
+        continue;
+      }
+
+      ++results.die_count;
+      index_die(entry, results.parents.empty() ? 0 : results.parents.back(), results);
+      if (entry.abbrev_entry()->has_children) results.parents.push_back(entry.tag());
+    }
+  }
+
+  bool name_less(const sdb::dwarf_index::named_die& lhs, const sdb::dwarf_index::named_die& rhs) {
+    if (lhs.name != rhs.name) return lhs.name < rhs.name;
+    return lhs.entry.position() < rhs.entry.position();
+  }
+
+  bool range_less(const sdb::dwarf_index::function_range& lhs, const sdb::dwarf_index::function_range& rhs) {
+    if (lhs.low != rhs.low) return lhs.low < rhs.low;
+    return lhs.function.position() < rhs.function.position();
+  }
+
+  /*
+    Merges sorted runs, one per worker, into a single sorted vector. Runs are merged in
+    pairs, with the pairs of each round merged in parallel, so the work is O(n log runs)
+    and spread over the workers rather than O(n * runs) on the calling thread.
+  */
+  template <class T, class Compare>
+  std::vector<T> merge_runs(std::vector<std::vector<T>> runs, Compare less, std::size_t n_threads) {
+    if (runs.empty()) return {};
+
+    while (runs.size() > 1) {
+      std::vector<std::vector<T>> merged((runs.size() + 1) / 2);
+      auto n_pairs = runs.size() / 2;
+      parallel_for(n_pairs, std::min(n_threads, n_pairs), [&](std::size_t i, std::size_t) {
+        auto& lhs = runs[2 * i];
+        auto& rhs = runs[2 * i + 1];
+        merged[i].reserve(lhs.size() + rhs.size());
+        std::merge(begin(lhs), end(lhs), begin(rhs), end(rhs), std::back_inserter(merged[i]), less);
+        // Free each round's inputs as soon as they are merged
+        std::vector<T>().swap(lhs);
+        std::vector<T>().swap(rhs);
+      });
+      if (runs.size() % 2 != 0) merged.back() = std::move(runs.back());
+      runs = std::move(merged);
+    }
+    return std::move(runs.front());
+  }
+
+  std::vector<sdb::die> find_by_name(const std::vector<sdb::dwarf_index::named_die>& entries, std::string_view name) {
+    auto first = std::lower_bound(begin(entries), end(entries), name, [](auto& entry, auto name) {
+      return entry.name < name;
+    });
+
+    std::vector<sdb::die> ret;
+    for (auto it = first; it != end(entries) and it->name == name; ++it) {
+      ret.push_back(it->entry);
+    }
+    return ret;
+  }
+}
+
+sdb::dwarf_index::dwarf_index(const dwarf& parent, std::size_t n_threads) {
+  auto& units = parent.compile_units();
+  auto n_workers = worker_count(n_threads, units.size());
+
+  std::vector<index_results> results(n_workers);
+  parallel_for(units.size(), n_workers, [&](std::size_t unit, std::size_t worker) {
+    index_compile_unit(*units[unit], results[worker]);
+  });
+
+  // Each worker sorts what it found so that only a merge is left for this thread
+  parallel_for(n_workers, n_workers, [&](std::size_t worker, std::size_t) {
+    auto& found = results[worker];
+    std::sort(begin(found.functions), end(found.functions), name_less);
+    std::sort(begin(found.variables), end(found.variables), name_less);
+    std::sort(begin(found.types), end(found.types), name_less);
+    std::sort(begin(found.function_ranges), end(found.function_ranges), range_less);
+  });
+
+  std::vector<std::vector<named_die>> functions, variables, types;
+  std::vector<std::vector<function_range>> ranges;
+  for (auto& found : results) {
+    functions.push_back(std::move(found.functions));
+    variables.push_back(std::move(found.variables));
+    types.push_back(std::move(found.types));
+    ranges.push_back(std::move(found.function_ranges));
+    die_count_ += found.die_count;
+  }
+  functions_ = merge_runs(std::move(functions), name_less, n_workers);
+  variables_ = merge_runs(std::move(variables), name_less, n_workers);
+  types_ = merge_runs(std::move(types), name_less, n_workers);
+  function_ranges_ = merge_runs(std::move(ranges), range_less, n_workers);
+}
+
+std::vector<sdb::die> sdb::dwarf_index::find_functions(std::string_view name) const {
+  return find_by_name(functions_, name);
+}
+
+std::vector<sdb::die> sdb::dwarf_index::find_variables(std::string_view name) const {
+  return find_by_name(variables_, name);
+}
+
+std::vector<sdb::die> sdb::dwarf_index::find_types(std::string_view name) const {
+  return find_by_name(types_, name);
+}
+
+std::optional<sdb::die> sdb::dwarf_index::function_containing_address(file_addr address) const {
+  auto it = std::upper_bound(begin(function_ranges_), end(function_ranges_), address.addr(), [](auto addr, auto& range) {
+    return addr < range.low;
+  });
+  if (it == begin(function_ranges_)) return std::nullopt;
+
+  --it;
+  if (address.addr() < it->high) return it->function;
+  return std::nullopt;
 }
@@ -1,24 +1,114 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <tuple>
 #include <cxxabi.h>
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <thread>
 #include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
 #include <libsdb/elf.hpp>
 #include <libsdb/error.hpp>
 #include <libsdb/bit.hpp>
+#include <libsdb/index_cache.hpp>
 
-sdb::elf::elf(const std::filesystem::path& path) {
-  path_ = path;
+namespace {
+  // FNV-1a, which unlike std::hash is stable across runs and so can be stored in the index cache
+  std::uint64_t hash_name(std::string_view name) {
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (auto c : name) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+    }
+    return hash;
+  }
+
+  // The CRC-32 that .gnu_debuglink records for the debug file, as used by zlib
+  std::uint32_t crc32(sdb::span<const std::byte> data) {
+    static const auto table = [] {
+      std::array<std::uint32_t, 256> ret;
+      for (std::uint32_t i = 0; i < 256; ++i) {
+        auto crc = i;
+        for (auto bit = 0; bit < 8; ++bit) {
+          crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+        }
+        ret[i] = crc;
+      }
+      return ret;
+    }();
 
-  if ((fd_ = open(path.c_str(), O_RDONLY)) < 0) {
-    error::send_errno("Could not open ELF file");
+    std::uint32_t crc = 0xffffffff;
+    for (auto byte : data) {
+      crc = table[(crc ^ std::to_integer<std::uint32_t>(byte)) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
   }
 
+  const std::filesystem::path debug_root = "/usr/lib/debug";
+
+  // Identifies a file on disk; a rebuilt file gets a new modification time even if it keeps its inode
+  struct file_identity {
+    dev_t device;
+    ino_t inode;
+    std::int64_t mtime_sec;
+    std::int64_t mtime_nsec;
+    off_t size;
+
+    bool operator<(const file_identity& rhs) const {
+      return std::tie(device, inode, mtime_sec, mtime_nsec, size) <
+        std::tie(rhs.device, rhs.inode, rhs.mtime_sec, rhs.mtime_nsec, rhs.size);
+    }
+  };
+
+  // Images are only kept alive by the elfs using them
+  std::mutex image_cache_mutex;
+  std::map<file_identity, std::weak_ptr<const sdb::elf_image>> image_cache;
+
+  std::atomic<std::size_t> decompression_limit = std::size_t(256) << 20;
+
+  int open_elf_file(const std::filesystem::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) sdb::error::send_errno("Could not open ELF file");
+    return fd;
+  }
+}
+
+namespace {
+  /*
+    The image is shared by every elf for the file, so it can't keep the path it was first
+    opened through, which may be a link such as /proc/<pid>/exe that stops resolving once
+    that process exits. The descriptor names the file itself.
+  */
+  std::filesystem::path resolve_path(const std::filesystem::path& path, int fd) {
+    std::error_code ec;
+    auto resolved = std::filesystem::read_symlink("/proc/self/fd/" + std::to_string(fd), ec);
+    if (ec or resolved.is_relative() or resolved.string().find(" (deleted)") != std::string::npos) {
+      return std::filesystem::absolute(path, ec);
+    }
+    return resolved;
+  }
+}
+
+// Older C libraries predate zstd support in ELF
+#ifndef ELFCOMPRESS_ZSTD
+#define ELFCOMPRESS_ZSTD 2
+#endif
+
+sdb::elf_image::elf_image(const std::filesystem::path& path)
+  : elf_image(path, open_elf_file(path)) {}
+
+sdb::elf_image::elf_image(const std::filesystem::path& path, int fd) {
+  path_ = resolve_path(path, fd);
+  fd_ = fd;
+
   // Need to specify 'struct' because 'stat' already exists as a function in the global namespace
   struct stat stats;
   if (fstat(fd_, &stats) < 0) {
+    close(fd_);
     error::send_errno("Could not retrieve ELF file stats");
   }
   file_size_ = stats.st_size;
@@ -33,25 +123,75 @@ sdb::elf::elf(const std::filesystem::path& path) {
 
   data_ = reinterpret_cast<std::byte*>(ret);
 
-  std::copy(data_, data_ + sizeof(header_), as_bytes(header_));
+  try {
+    parse();
+  } catch (...) {
+    // The destructor won't run for a partially constructed object
+    munmap(data_, file_size_);
+    close(fd_);
+    throw;
+  }
+}
 
-  parse_section_headers();
-  build_section_map();
-  parse_symbol_table();
-  build_symbol_maps();
+sdb::elf_image::elf_image(std::filesystem::path name, std::vector<std::byte> contents) {
+  path_ = std::move(name);
+  fd_ = -1;
+  contents_ = std::move(contents);
+  file_size_ = contents_.size();
+  data_ = contents_.data();
+
+  parse();
+}
+
+sdb::elf_image::~elf_image() {
+  // The prefetch thread reads from the mapping
+  if (prefetch_thread_.joinable()) prefetch_thread_.join();
+  if (fd_ >= 0) {
+    munmap(data_, file_size_);
+    close(fd_);
+  }
+}
+
+std::shared_ptr<const sdb::elf_image> sdb::elf_image::from_memory(std::filesystem::path name, std::vector<std::byte> contents) {
+  return std::shared_ptr<const elf_image>(new elf_image(std::move(name), std::move(contents)));
 }
 
-sdb::elf::~elf() {
-  munmap(data_, file_size_);
-  close(fd_);
+std::shared_ptr<const sdb::elf_image> sdb::elf_image::open(const std::filesystem::path& path) {
+  // Identify the file through the descriptor that will be mapped, so that the key can't
+  // describe a different file if the path is replaced in the meantime
+  int fd = open_elf_file(path);
+  struct stat stats;
+  if (fstat(fd, &stats) < 0) {
+    close(fd);
+    error::send_errno("Could not retrieve ELF file stats");
+  }
+  file_identity key{ stats.st_dev, stats.st_ino, stats.st_mtim.tv_sec, stats.st_mtim.tv_nsec, stats.st_size };
+
+  std::lock_guard lock(image_cache_mutex);
+  if (auto it = image_cache.find(key); it != image_cache.end()) {
+    if (auto image = it->second.lock()) {
+      close(fd);
+      return image;
+    }
+  }
+
+  // Parsing happens under the lock so that concurrent opens of one file don't both parse it
+  std::shared_ptr<const elf_image> image(new elf_image(path, fd));
+
+  // Drop the entries of images nobody uses any more, such as those of rebuilt files
+  for (auto it = image_cache.begin(); it != image_cache.end();) {
+    it = it->second.expired() ? image_cache.erase(it) : std::next(it);
+  }
+  image_cache[key] = image;
+  return image;
 }
 
-std::string_view sdb::elf::get_section_name(std::size_t index) const {
+std::string_view sdb::elf_image::get_section_name(std::size_t index) const {
   auto& section = section_headers_[header_.e_shstrndx];
   return { reinterpret_cast<char*>(data_) + section.sh_offset + index };
 }
 
-std::optional<const Elf64_Shdr*> sdb::elf::get_section(std::string_view name) const {
+std::optional<const Elf64_Shdr*> sdb::elf_image::get_section(std::string_view name) const {
   if (section_map_.count(name) == 0) {
     return std::nullopt;
   }
@@ -59,172 +199,904 @@ std::optional<const Elf64_Shdr*> sdb::elf::get_section(std::string_view name) co
   return section_map_.at(name);
 }
 
-sdb::span<const std::byte> sdb::elf::get_section_contents(std::string_view name) const {
-  if (auto sect = get_section(name); sect) {
-    return { data_ + sect.value()->sh_offset, sect.value()->sh_size };
+sdb::elf_image::section_data sdb::elf_image::get_section_data(std::string_view name) const {
+  auto sect = get_section(name);
+  if (!sect) {
+    if (name.substr(0, 7) == ".debug_") {
+      if (auto debug = debug_file()) return debug->get_section_data(name);
+    }
+    return { { nullptr, std::size_t(0) }, nullptr };
   }
 
-  return { nullptr, std::size_t(0) };
+  auto& section = *sect.value();
+  if (!(section.sh_flags & SHF_COMPRESSED)) {
+    return { { data_ + section.sh_offset, section.sh_size }, nullptr };
+  }
+
+  auto data = get_decompressed(section);
+  return { { data->data(), data->size() }, data };
 }
 
-std::string_view sdb::elf::get_string(std::size_t index) const {
-  auto opt_strtab = get_section(".strtab");
+sdb::span<const std::byte> sdb::elf_image::get_section_contents(std::string_view name) const {
+  return get_section_data(name).bytes;
+}
 
-  if (!opt_strtab) {
-    opt_strtab = get_section(".dynstr");
-    if (!opt_strtab) return "";
+void sdb::elf_image::prefetch_compressed_sections() const {
+  auto compressed = [](auto& section) { return (section.sh_flags & SHF_COMPRESSED) != 0; };
+  if (prefetch_thread_.joinable() or std::none_of(section_headers_.begin(), section_headers_.end(), compressed)) {
+    return;
   }
 
-  return {
-    reinterpret_cast<char*>(data_) + opt_strtab.value()->sh_offset + index
-  };
+  prefetch_thread_ = std::thread([this, compressed] {
+    for (auto& section : section_headers_) {
+      if (!compressed(section)) continue;
+      try {
+        get_decompressed(section);
+      } catch (...) {
+        // Reported again to whoever looks the section up
+      }
+    }
+  });
 }
 
-const Elf64_Shdr* sdb::elf::get_section_containing_address(file_addr addr) const {
-  if (addr.elf_file() != this) return nullptr;
+void sdb::elf_image::set_decompression_cache_limit(std::size_t bytes) {
+  decompression_limit = bytes;
+}
 
-  for (auto& section : section_headers_) {
-    if (section.sh_addr <= addr.addr() and
-        section.sh_addr + section.sh_size > addr.addr()) {
-      return &section;
+std::size_t sdb::elf_image::decompression_cache_limit() {
+  return decompression_limit;
+}
+
+std::string_view sdb::elf_image::get_string(std::size_t index) const {
+  if (auto file = symbol_file(); file != this) return file->get_string(index);
+  return string_at(index);
+}
+
+sdb::span<const Elf64_Sym> sdb::elf_image::symbols() const {
+  if (auto file = symbol_file(); file != this) return file->symbols();
+  return symbol_table_;
+}
+
+std::string_view sdb::elf_image::string_at(std::size_t index) const {
+  if (!string_table_ or index >= string_table_size_) return "";
+  return { string_table_ + index };
+}
+
+const Elf64_Shdr* sdb::elf_image::get_section_containing_address(std::uint64_t address) const {
+  auto it = std::upper_bound(begin(sections_by_address_), end(sections_by_address_), address,
+    [](auto address, auto section) { return address < section->sh_addr; });
+  if (it == begin(sections_by_address_)) return nullptr;
+
+  --it;
+  return address < (*it)->sh_addr + (*it)->sh_size ? *it : nullptr;
+}
+
+const Elf64_Phdr* sdb::elf_image::get_segment_containing_address(std::uint64_t address) const {
+  auto it = std::upper_bound(begin(segments_by_address_), end(segments_by_address_), address,
+    [](auto address, auto segment) { return address < segment->p_vaddr; });
+  if (it == begin(segments_by_address_)) return nullptr;
+
+  --it;
+  return address < (*it)->p_vaddr + (*it)->p_memsz ? *it : nullptr;
+}
+
+std::optional<std::uint64_t> sdb::elf_image::get_file_offset(std::uint64_t address) const {
+  auto segment = get_segment_containing_address(address);
+  if (!segment) return std::nullopt;
+
+  auto offset = address - segment->p_vaddr;
+  if (offset >= segment->p_filesz) return std::nullopt;
+  return segment->p_offset + offset;
+}
+
+std::optional<std::uint64_t> sdb::elf_image::get_file_addr(std::uint64_t offset) const {
+  for (auto segment : segments_by_address_) {
+    if (offset >= segment->p_offset and offset < segment->p_offset + segment->p_filesz) {
+      return segment->p_vaddr + (offset - segment->p_offset);
     }
   }
+  return std::nullopt;
+}
 
-  return nullptr;
+std::optional<sdb::span<const std::byte>> sdb::elf_image::get_bytes(std::uint64_t address, std::size_t size) const {
+  auto segment = get_segment_containing_address(address);
+  if (!segment) return std::nullopt;
+
+  auto offset = address - segment->p_vaddr;
+  if (size > segment->p_filesz or offset > segment->p_filesz - size or
+      segment->p_offset + segment->p_filesz > file_size_) {
+    return std::nullopt;
+  }
+  return span<const std::byte>{ data_ + segment->p_offset + offset, size };
 }
 
-const Elf64_Shdr* sdb::elf::get_section_containing_address(virt_addr addr) const {
-  for (auto& section : section_headers_) {
-    if (load_bias_ + section.sh_addr <= addr and
-        load_bias_ + section.sh_addr + section.sh_size > addr) {
-      return &section;
+std::vector<const Elf64_Sym*> sdb::elf_image::get_symbols_by_name(std::string_view name) const {
+  if (auto file = symbol_file(); file != this) return file->get_symbols_by_name(name);
+
+  std::vector<const Elf64_Sym*> ret;
+
+  // The hash table holds every defined name as it appears in the file, so only a name that
+  // could be demangled needs the full index, which is expensive to build
+  if (gnu_hash_) {
+    ret = lookup_gnu_hash(name);
+    auto maybe_demangled = name.find("::") != std::string_view::npos or
+      name.find_first_of("(<") != std::string_view::npos;
+    if (!ret.empty() or !maybe_demangled) return ret;
+  }
+
+  std::call_once(name_index_built_, [this] { build_name_index(); });
+
+  if (name_buckets_.size() == 0) return ret;
+
+  // Linear probing; each bucket holds the low half of the name's hash and its entry index plus one
+  auto hash = hash_name(name);
+  auto mask = name_buckets_.size() - 1;
+  for (auto i = hash & mask; name_buckets_[i] != 0; i = (i + 1) & mask) {
+    auto bucket = name_buckets_[i];
+    if ((bucket >> 32) != (hash & 0xffffffff)) continue;
+
+    auto& entry = name_entries_[(bucket & 0xffffffff) - 1];
+    if (entry_name(entry) == name) {
+      ret.push_back(&symbol_table_[entry.symbol]);
     }
   }
 
-  return nullptr;
+  return ret;
 }
 
-std::optional<sdb::file_addr> sdb::elf::get_section_start_address(std::string_view name) const {
-  if (auto sect = get_section(name); sect) {
-    return file_addr{ *this, sect.value()->sh_addr };
-  }
+std::optional<const Elf64_Sym*> sdb::elf_image::get_symbol_at_address(std::uint64_t address) const {
+  if (auto file = symbol_file(); file != this) return file->get_symbol_at_address(address);
 
-  return std::nullopt;
+  auto index = find_symbol_index(address);
+  if (index == std::string::npos or symbol_starts_[index] != address) return std::nullopt;
+
+  return &symbol_table_[symbols_by_start_[index]];
 }
 
-std::vector<const Elf64_Sym*> sdb::elf::get_symbols_by_name(std::string_view name) const {
-  auto [begin, end] = symbol_name_map_.equal_range(name);
-  std::vector<const Elf64_Sym*> ret;
-  std::transform(begin, end, std::back_inserter(ret), [](auto& pair) { return pair.second; });
+std::optional<const Elf64_Sym*> sdb::elf_image::get_symbol_containing_address(std::uint64_t address) const {
+  if (auto file = symbol_file(); file != this) return file->get_symbol_containing_address(address);
+
+  return symbol_containing(find_symbol_index(address), address);
+}
+
+std::vector<std::optional<const Elf64_Sym*>> sdb::elf_image::symbolize(span<const std::uint64_t> addresses) const {
+  if (auto file = symbol_file(); file != this) return file->symbolize(addresses);
+
+  std::call_once(address_index_built_, [this] { build_symbol_maps(); });
+
+  std::vector<std::optional<const Elf64_Sym*>> ret;
+  ret.reserve(addresses.size());
+
+  auto index = std::string::npos;
+  std::uint64_t previous = 0;
+
+  for (auto address : addresses) {
+    if (index == std::string::npos or address < previous) {
+      // First address or out of order, so fall back to a search
+      index = find_symbol_index(address);
+    } else {
+      while (index + 1 < symbol_starts_.size() and symbol_starts_[index + 1] <= address) {
+        ++index;
+      }
+    }
+    previous = address;
+
+    ret.push_back(symbol_containing(index, address));
+  }
+
   return ret;
 }
 
-std::optional<const Elf64_Sym*> sdb::elf::get_symbol_at_address(file_addr address) const {
-  if (address.elf_file() != this) return std::nullopt;
+const sdb::elf_image* sdb::elf_image::debug_file() const {
+  if (is_debug_file_) return nullptr;
 
-  file_addr null_addr;
-  auto it = symbol_addr_map_.find({ address, null_addr });
-  if (it == end(symbol_addr_map_)) return std::nullopt;
+  std::call_once(debug_file_found_, [this] {
+    // A file that already has both symbols and DWARF has nothing to gain
+    if (get_section(".symtab") and get_section(".debug_info")) return;
 
-  return it->second;
+    debug_file_ = find_debug_file();
+  });
+  return debug_file_.get();
 }
 
-std::optional<const Elf64_Sym*> sdb::elf::get_symbol_at_address(virt_addr address) const {
-  return get_symbol_at_address(address.to_file_addr(*this));
+/* private methods  */
+void sdb::elf_image::parse() {
+  if (file_size_ < sizeof(header_)) error::send("ELF file is truncated");
+  std::copy(data_, data_ + sizeof(header_), as_bytes(header_));
+  if (std::memcmp(header_.e_ident, ELFMAG, SELFMAG) != 0) error::send("Not an ELF file");
+
+  parse_section_headers();
+  parse_program_headers();
+  build_section_map();
+  parse_symbol_table();
+  parse_gnu_hash();
+  read_build_id();
+  // Otherwise the indexes are built when they are first needed
+  load_cached_indexes();
 }
 
-std::optional<const Elf64_Sym*> sdb::elf::get_symbol_containing_address(file_addr address) const {
-  if (address.elf_file() != this or symbol_addr_map_.empty()) {
-    return std::nullopt;
+sdb::elf_image::decompressed_bytes sdb::elf_image::get_decompressed(const Elf64_Shdr& section) const {
+  std::unique_lock lock(decompression_mutex_);
+
+  auto it = std::find_if(begin(decompressed_), end(decompressed_), [&](auto& entry) {
+    return entry.section == &section;
+  });
+  if (it != end(decompressed_)) {
+    decompressed_.splice(begin(decompressed_), decompressed_, it);
+    auto data = it->data;
+    lock.unlock();
+    // Waits if another thread is still decompressing it
+    return data.get();
+  }
+
+  // Claim the section before unlocking so that nobody else decompresses it too
+  std::promise<decompressed_bytes> promise;
+  auto future = promise.get_future().share();
+  decompressed_.push_front({ &section, future, 0 });
+  lock.unlock();
+
+  std::size_t size = 0;
+  try {
+    auto data = decompress(section);
+    size = data->size();
+    promise.set_value(std::move(data));
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+
+  lock.lock();
+  it = std::find_if(begin(decompressed_), end(decompressed_), [&](auto& entry) {
+    return entry.section == &section;
+  });
+  it->size = size;
+  decompressed_size_ += size;
+
+  // Evict from the least recently used end, skipping this section and any still in progress
+  auto limit = decompression_limit.load();
+  for (auto victim = decompressed_.end(); decompressed_size_ > limit and victim != decompressed_.begin();) {
+    --victim;
+    if (victim == it or victim->size == 0) continue;
+    decompressed_size_ -= victim->size;
+    victim = decompressed_.erase(victim);
+  }
+  lock.unlock();
+
+  return future.get();
+}
+
+sdb::elf_image::decompressed_bytes sdb::elf_image::decompress(const Elf64_Shdr& section) const {
+  auto name = std::string(get_section_name(section.sh_name));
+  if (section.sh_offset > file_size_ or section.sh_size > file_size_ - section.sh_offset) {
+    error::send("Compressed section " + name + " is truncated");
+  }
+  if (section.sh_size < sizeof(Elf64_Chdr)) {
+    error::send("Compressed section " + name + " has no compression header");
+  }
+
+  auto header = from_bytes<Elf64_Chdr>(data_ + section.sh_offset);
+  auto source = data_ + section.sh_offset + sizeof(Elf64_Chdr);
+  auto source_size = section.sh_size - sizeof(Elf64_Chdr);
+
+  // ch_size comes straight from the file, so bound it before allocating. zlib can't do better
+  // than about 1032:1, and debug sections compress nowhere near that with either format.
+  constexpr std::uint64_t max_ratio = 1032;
+  if (header.ch_size > source_size * max_ratio + 4096) {
+    error::send("Compressed section " + name + " claims an implausible decompressed size");
   }
 
-  file_addr null_addr;
-  auto it = symbol_addr_map_.lower_bound({ address, null_addr });
+  std::shared_ptr<std::vector<std::byte>> out;
+  try {
+    out = std::make_shared<std::vector<std::byte>>(header.ch_size);
+  } catch (const std::bad_alloc&) {
+    error::send("Not enough memory to decompress section " + name);
+  }
 
-  if (it != end(symbol_addr_map_)) {
-    if (auto [key, value] = *it; key.first == address) {
-      return value;
+  if (header.ch_type == ELFCOMPRESS_ZLIB) {
+    uLongf size = header.ch_size;
+    auto result = uncompress(
+      reinterpret_cast<Bytef*>(out->data()), &size, reinterpret_cast<const Bytef*>(source), source_size);
+    if (result != Z_OK or size != header.ch_size) {
+      error::send("Could not decompress zlib section " + name);
+    }
+  } else if (header.ch_type == ELFCOMPRESS_ZSTD) {
+    auto size = ZSTD_decompress(out->data(), out->size(), source, source_size);
+    if (ZSTD_isError(size) or size != header.ch_size) {
+      error::send("Could not decompress zstd section " + name);
     }
+  } else {
+    error::send("Section " + name + " uses an unsupported compression type");
   }
 
-  if (it == begin(symbol_addr_map_)) return std::nullopt;
+  return out;
+}
 
-  --it;
-  if (auto [key, value] = *it; key.first < address and key.second > address) {
-    return value;
+std::unique_ptr<sdb::elf_image> sdb::elf_image::find_debug_file() const {
+  // Debug files are private to this image rather than shared through the cache, so they can be marked as such
+  auto open_debug_file = [](const std::filesystem::path& path) -> std::unique_ptr<elf_image> {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) return nullptr;
+
+    try {
+      std::unique_ptr<elf_image> debug(new elf_image(path));
+      debug->is_debug_file_ = true;
+      return debug;
+    } catch (const error&) {
+      return nullptr;
+    }
+  };
+
+  // The build ID identifies the exact build, so no checksum is needed
+  if (build_id_ and build_id_->size() > 2) {
+    auto path = debug_root / ".build-id" / build_id_->substr(0, 2) / (build_id_->substr(2) + ".debug");
+    if (auto debug = open_debug_file(path); debug and debug->build_id() == build_id_) return debug;
   }
 
-  return std::nullopt;
+  // .gnu_debuglink holds a NUL-terminated file name, padded to four bytes, then the file's CRC-32
+  auto link = get_section_contents(".gnu_debuglink");
+  auto name_end = std::find(link.begin(), link.end(), std::byte{ 0 });
+  auto crc_offset = ((name_end - link.begin()) + 4) & ~std::size_t(3);
+  if (name_end == link.begin() or crc_offset + sizeof(std::uint32_t) > link.size()) return nullptr;
+
+  std::string name(reinterpret_cast<const char*>(link.begin()), name_end - link.begin());
+  auto crc = from_bytes<std::uint32_t>(link.begin() + crc_offset);
+
+  // Images read from memory only have a name, so that may still need resolving
+  std::error_code ec;
+  auto real_path = std::filesystem::canonical(path_, ec);
+  auto dir = (ec ? std::filesystem::absolute(path_) : real_path).parent_path();
+
+  for (auto& path : { dir / name, dir / ".debug" / name, debug_root / dir.relative_path() / name }) {
+    if (path == real_path) continue;
+
+    auto debug = open_debug_file(path);
+    if (debug and crc32({ debug->data_, debug->file_size_ }) == crc) return debug;
+  }
+
+  return nullptr;
 }
 
-std::optional<const Elf64_Sym*> sdb::elf::get_symbol_containing_address(virt_addr address) const {
-  return get_symbol_containing_address(address.to_file_addr(*this));
+const sdb::elf_image* sdb::elf_image::symbol_file() const {
+  if (get_section(".symtab")) return this;
+
+  auto debug = debug_file();
+  return debug and debug->get_section(".symtab") ? debug : this;
 }
 
 
-/* private methods  */
-void sdb::elf::build_section_map() {
+void sdb::elf_image::build_section_map() {
   for (auto& section : section_headers_) {
     section_map_[get_section_name(section.sh_name)] = &section;
-  }  
+
+    // Thread-local .tbss takes no space in the image and overlaps whatever follows it
+    bool is_tbss = (section.sh_flags & SHF_TLS) and section.sh_type == SHT_NOBITS;
+    if ((section.sh_flags & SHF_ALLOC) and section.sh_size != 0 and !is_tbss) {
+      sections_by_address_.push_back(&section);
+    }
+  }
+
+  std::sort(begin(sections_by_address_), end(sections_by_address_), [](auto lhs, auto rhs) {
+    return lhs->sh_addr < rhs->sh_addr;
+  });
+
+  for (auto& segment : program_headers_) {
+    if (segment.p_type == PT_LOAD and segment.p_memsz != 0) {
+      segments_by_address_.push_back(&segment);
+    }
+  }
+
+  std::sort(begin(segments_by_address_), end(segments_by_address_), [](auto lhs, auto rhs) {
+    return lhs->p_vaddr < rhs->p_vaddr;
+  });
 }
 
-void sdb::elf::parse_section_headers() {
-  auto n_headers = header_.e_shnum;
+template <class T>
+sdb::span<const T> sdb::elf_image::view_table(
+  std::uint64_t offset, std::size_t count, std::vector<T>& fallback, const char* what) const {
+  if (offset > file_size_ or count > (file_size_ - offset) / sizeof(T)) {
+    error::send(std::string("ELF ") + what + " is truncated");
+  }
 
+  // The mapping is page-aligned, so the table can be used in place if its offset is aligned
+  auto start = data_ + offset;
+  if (offset % alignof(T) == 0) {
+    return { reinterpret_cast<const T*>(start), count };
+  }
+
+  fallback.resize(count);
+  std::copy(start, start + count * sizeof(T), reinterpret_cast<std::byte*>(fallback.data()));
+  return { fallback.data(), fallback.size() };
+}
+
+void sdb::elf_image::parse_section_headers() {
+  std::size_t n_headers = header_.e_shnum;
+
+  // Files with too many sections to count in e_shnum store the count in the first header
   if (n_headers == 0 and header_.e_shentsize != 0) {
-    n_headers = from_bytes<Elf64_Shdr>(data_ + header_.e_shoff).sh_size;
+    n_headers = view_table(header_.e_shoff, 1, section_headers_copy_, "section headers")[0].sh_size;
   }
 
-  
-  section_headers_.resize(n_headers);
+  section_headers_ = view_table(header_.e_shoff, n_headers, section_headers_copy_, "section headers");
+  if (n_headers != 0 and header_.e_shstrndx >= n_headers) {
+    error::send("ELF section name table index is invalid");
+  }
+}
 
-  std::copy(
-    data_ + header_.e_shoff,
-    data_ + header_.e_shoff + sizeof(Elf64_Shdr) * n_headers,
-    reinterpret_cast<std::byte*>(section_headers_.data())
-  );
+void sdb::elf_image::parse_program_headers() {
+  program_headers_ = view_table(header_.e_phoff, header_.e_phnum, program_headers_copy_, "program headers");
 }
 
-void sdb::elf::parse_symbol_table() {
+void sdb::elf_image::parse_symbol_table() {
   auto opt_symtab = get_section(".symtab");
   if (!opt_symtab) {
     opt_symtab = get_section(".dynsym");
-    if (!opt_symtab) return;
   }
 
-  auto symtab = *opt_symtab;
-  symbol_table_.resize(symtab->sh_size / symtab->sh_entsize);
-  std::copy(
-    data_ + symtab->sh_offset,
-    data_ + symtab->sh_offset + symtab->sh_size,
-    reinterpret_cast<std::byte*>(symbol_table_.data())
-  );
+  if (opt_symtab) {
+    auto symtab = *opt_symtab;
+    symbol_table_ = view_table(
+      symtab->sh_offset, symtab->sh_size / sizeof(Elf64_Sym), symbol_table_copy_, "symbol table");
+
+    // Symbol names live in the string table the symbol table links to
+    if (symtab->sh_link < section_headers_.size()) {
+      set_string_table(section_headers_[symtab->sh_link]);
+    }
+    return;
+  }
+
+  auto opt_strtab = get_section(".strtab");
+  if (!opt_strtab) opt_strtab = get_section(".dynstr");
+  if (opt_strtab) {
+    set_string_table(*opt_strtab.value());
+  }
+}
+
+void sdb::elf_image::set_string_table(const Elf64_Shdr& section) {
+  // Tables cut short by a truncated file keep only the part that is there
+  if (section.sh_offset > file_size_) return;
+  string_table_ = reinterpret_cast<const char*>(data_) + section.sh_offset;
+  string_table_size_ = std::min<std::uint64_t>(section.sh_size, file_size_ - section.sh_offset);
+}
+
+void sdb::elf_image::parse_gnu_hash() {
+  /*
+    The hash table only covers the dynamic symbol table, so it can only answer
+    lookups on its own when that is the table in use, as it is for stripped binaries
+  */
+  auto hash_section = get_section(".gnu.hash");
+  auto dynsym = get_section(".dynsym");
+  if (!hash_section or !dynsym or get_section(".symtab")) return;
+  if (section_headers_.begin() + hash_section.value()->sh_link != dynsym.value()) return;
+
+  auto offset = hash_section.value()->sh_offset;
+  auto size = hash_section.value()->sh_size;
+  if (size < 4 * sizeof(std::uint32_t)) return;
+
+  auto table = std::make_unique<gnu_hash_table>();
+  auto header = view_table(offset, 4, table->header_copy, ".gnu.hash header");
+  auto n_buckets = header[0];
+  table->symbol_offset = header[1];
+  auto bloom_size = header[2];
+  table->bloom_shift = header[3];
+
+  // Chains cover every dynamic symbol from symbol_offset on
+  if (n_buckets == 0 or bloom_size == 0 or table->symbol_offset > symbol_table_.size()) return;
+  auto n_chain = symbol_table_.size() - table->symbol_offset;
+  auto bloom_offset = offset + 4 * sizeof(std::uint32_t);
+  auto buckets_offset = bloom_offset + bloom_size * sizeof(std::uint64_t);
+  if (buckets_offset + (n_buckets + n_chain) * sizeof(std::uint32_t) > offset + size) return;
+
+  table->bloom = view_table(bloom_offset, bloom_size, table->bloom_copy, ".gnu.hash bloom filter");
+  table->buckets = view_table(buckets_offset, n_buckets, table->buckets_copy, ".gnu.hash buckets");
+  table->chain = view_table(
+    buckets_offset + n_buckets * sizeof(std::uint32_t), n_chain, table->chain_copy, ".gnu.hash chains");
+
+  gnu_hash_ = std::move(table);
+}
+
+std::vector<const Elf64_Sym*> sdb::elf_image::lookup_gnu_hash(std::string_view name) const {
+  auto& table = *gnu_hash_;
+  std::vector<const Elf64_Sym*> ret;
+
+  std::uint32_t hash = 5381;
+  for (auto c : name) {
+    hash = hash * 33 + static_cast<unsigned char>(c);
+  }
+
+  // The bloom filter rejects most absent names after a single load
+  auto word = table.bloom[(hash / 64) % table.bloom.size()];
+  std::uint64_t mask = (std::uint64_t(1) << (hash % 64)) | (std::uint64_t(1) << ((hash >> table.bloom_shift) % 64));
+  if ((word & mask) != mask) return ret;
+
+  std::size_t index = table.buckets[hash % table.buckets.size()];
+  if (index < table.symbol_offset) return ret;
+
+  // Each chain entry holds the symbol's hash with the low bit marking the end of the chain
+  for (; index - table.symbol_offset < table.chain.size(); ++index) {
+    auto chain_hash = table.chain[index - table.symbol_offset];
+    if ((chain_hash | 1) == (hash | 1) and string_at(symbol_table_[index].st_name) == name) {
+      ret.push_back(&symbol_table_[index]);
+    }
+    if (chain_hash & 1) break;
+  }
+
+  return ret;
+}
+
+void sdb::elf_image::read_build_id() {
+  auto align4 = [](std::size_t n) { return (n + 3) & ~std::size_t(3); };
+
+  for (auto& section : section_headers_) {
+    if (section.sh_type != SHT_NOTE or section.sh_offset > file_size_) continue;
+
+    auto pos = data_ + section.sh_offset;
+    auto end = pos + std::min<std::uint64_t>(section.sh_size, file_size_ - section.sh_offset);
+    while (pos + sizeof(Elf64_Nhdr) <= end) {
+      auto note = from_bytes<Elf64_Nhdr>(pos);
+      auto name = pos + sizeof(Elf64_Nhdr);
+      auto desc = name + align4(note.n_namesz);
+      if (desc + note.n_descsz > end) break;
+
+      if (note.n_type == NT_GNU_BUILD_ID and note.n_namesz == 4 and
+          std::equal(name, name + 4, reinterpret_cast<const std::byte*>("GNU"))) {
+        constexpr char digits[] = "0123456789abcdef";
+        std::string id;
+        for (auto byte = desc; byte < desc + note.n_descsz; ++byte) {
+          id += digits[std::to_integer<int>(*byte) >> 4];
+          id += digits[std::to_integer<int>(*byte) & 0xf];
+        }
+        build_id_ = std::move(id);
+        return;
+      }
+
+      pos = desc + align4(note.n_descsz);
+    }
+  }
+}
+
+std::string sdb::elf_image::cache_key() const {
+  // A stripped binary shares its build ID with the original, so tell them apart by symbol count
+  return *build_id_ + "-" + std::to_string(symbol_table_.size());
 }
 
-void sdb::elf::build_symbol_maps() {
-  for (auto& symbol : symbol_table_) {
-    auto mangled_name = get_string(symbol.st_name);
-    int demangle_status;
+bool sdb::elf_image::load_cached_indexes() {
+  if (!build_id_) return false;
 
-    auto demangled_name = abi::__cxa_demangle(mangled_name.data(), nullptr, nullptr, &demangle_status);
+  auto cache = index_cache::load(cache_key());
+  if (!cache) return false;
 
-    if (demangle_status == 0) {
-      symbol_name_map_.insert({ demangled_name, &symbol });
-      free(demangled_name);
+  // The two indexes are saved as they are built, so either may be missing
+  address_index_from_cache_ = load_cached_address_index(*cache);
+  name_index_from_cache_ = load_cached_name_index(*cache);
+  if (!address_index_from_cache_ and !name_index_from_cache_) return false;
+
+  cache_ = std::move(cache);
+  return true;
+}
+
+// Only the shapes, indices and name ranges are checked, so that a corrupt file can't cause out of bounds reads
+bool sdb::elf_image::load_cached_address_index(const index_cache& cache) {
+  auto starts = cache.get_array<std::uint64_t>(index_cache::tag::symbol_starts);
+  auto ends = cache.get_array<std::uint64_t>(index_cache::tag::symbol_ends);
+  auto symbols = cache.get_array<std::uint32_t>(index_cache::tag::symbols_by_start);
+  auto tree = cache.get_array<std::uint64_t>(index_cache::tag::start_tree);
+  auto tree_index = cache.get_array<std::uint32_t>(index_cache::tag::start_tree_index);
+  if (!starts or !ends or !symbols or !tree or !tree_index) return false;
+
+  auto n = starts->size();
+  if (ends->size() != n or symbols->size() != n or tree->size() != n + 1 or tree_index->size() != n + 1) {
+    return false;
+  }
+  if (!std::all_of(symbols->begin(), symbols->end(), [this](auto i) { return i < symbol_table_.size(); }) or
+      !std::all_of(tree_index->begin() + 1, tree_index->end(), [n](auto i) { return i < n; })) {
+    return false;
+  }
+
+  symbol_starts_ = *starts;
+  symbol_ends_ = *ends;
+  symbols_by_start_ = *symbols;
+  start_tree_ = *tree;
+  start_tree_index_ = *tree_index;
+  std::call_once(address_index_built_, [] {});
+  address_index_ready_ = true;
+  return true;
+}
+
+bool sdb::elf_image::load_cached_name_index(const index_cache& cache) {
+  auto names = cache.get_array<char>(index_cache::tag::demangled_names);
+  auto entries = cache.get_array<name_entry>(index_cache::tag::name_entries);
+  auto buckets = cache.get_array<std::uint64_t>(index_cache::tag::name_buckets);
+  if (!names or !entries or !buckets) return false;
+
+  auto n_buckets = buckets->size();
+  if ((n_buckets & (n_buckets - 1)) != 0 or entries->size() >= n_buckets + (n_buckets == 0)) return false;
+  for (auto& entry : *entries) {
+    auto names_size = entry.in_arena ? names->size() : string_table_size_;
+    if (entry.symbol >= symbol_table_.size() or entry.offset + std::uint64_t(entry.size) > names_size) {
+      return false;
     }
+  }
+  std::size_t n_used = 0;
+  for (auto bucket : *buckets) {
+    if ((bucket & 0xffffffff) > entries->size()) return false;
+    n_used += bucket != 0;
+  }
+  if (n_used != entries->size()) return false;
 
-    symbol_name_map_.insert({ mangled_name, &symbol });
+  demangled_names_ = *names;
+  name_entries_ = *entries;
+  name_buckets_ = *buckets;
+  std::call_once(name_index_built_, [] {});
+  name_index_ready_ = true;
+  return true;
+}
+
+void sdb::elf_image::save_cached_indexes() const {
+  if (!build_id_) return;
+
+  // Whichever index isn't ready yet is left out, and added when it is built
+  std::lock_guard lock(cache_save_mutex_);
+  index_cache::writer writer;
+  if (address_index_ready_) {
+    writer.add_array(index_cache::tag::symbol_starts, symbol_starts_);
+    writer.add_array(index_cache::tag::symbol_ends, symbol_ends_);
+    writer.add_array(index_cache::tag::symbols_by_start, symbols_by_start_);
+    writer.add_array(index_cache::tag::start_tree, start_tree_);
+    writer.add_array(index_cache::tag::start_tree_index, start_tree_index_);
+  }
+  if (name_index_ready_) {
+    writer.add_array(index_cache::tag::demangled_names, demangled_names_);
+    writer.add_array(index_cache::tag::name_entries, name_entries_);
+    writer.add_array(index_cache::tag::name_buckets, name_buckets_);
+  }
+  // Failing to write the cache only costs the next run some time
+  writer.commit(cache_key());
+}
 
+void sdb::elf_image::build_symbol_maps() const {
+  std::vector<std::uint32_t> symbols;
+  for (std::size_t i = 0; i < symbol_table_.size(); ++i) {
+    auto& symbol = symbol_table_[i];
     if (symbol.st_value != 0 and
         symbol.st_name != 0 and
         ELF64_ST_TYPE(symbol.st_info) != STT_TLS) { // STT_TLS is thread local storage
-      auto addr_range = std::pair(
-        file_addr{ *this, symbol.st_value },
-        file_addr{ *this, symbol.st_value + symbol.st_size }
-      );
+      symbols.push_back(i);
+    }
+  }
+
+  // Stable so that the first symbol in the table wins when several share an address
+  std::stable_sort(begin(symbols), end(symbols), [this](auto lhs, auto rhs) {
+    return symbol_table_[lhs].st_value < symbol_table_[rhs].st_value;
+  });
+
+  auto& starts = built_indexes_.symbol_starts;
+  for (auto index : symbols) {
+    auto& symbol = symbol_table_[index];
+    if (!starts.empty() and starts.back() == symbol.st_value) continue;
+
+    starts.push_back(symbol.st_value);
+    built_indexes_.symbol_ends.push_back(symbol.st_value + symbol.st_size);
+    built_indexes_.symbols_by_start.push_back(index);
+  }
+
+  // Node k has children 2k and 2k + 1; an in-order walk visits the starts in sorted order
+  auto& tree = built_indexes_.start_tree;
+  auto& tree_index = built_indexes_.start_tree_index;
+  tree.resize(starts.size() + 1);
+  tree_index.resize(starts.size() + 1);
+  std::size_t next = 0;
+  auto fill = [&](auto& self, std::size_t k) -> void {
+    if (k > starts.size()) return;
+    self(self, 2 * k);
+    tree[k] = starts[next];
+    tree_index[k] = next++;
+    self(self, 2 * k + 1);
+  };
+  fill(fill, 1);
+
+  symbol_starts_ = starts;
+  symbol_ends_ = built_indexes_.symbol_ends;
+  symbols_by_start_ = built_indexes_.symbols_by_start;
+  start_tree_ = tree;
+  start_tree_index_ = tree_index;
+  address_index_ready_ = true;
+
+  save_cached_indexes();
+}
+
+std::size_t sdb::elf_image::find_symbol_index(std::uint64_t address) const {
+  std::call_once(address_index_built_, [this] { build_symbol_maps(); });
+
+  // Descend to the first start greater than address, recording the path in the bits of k
+  auto n = symbol_starts_.size();
+  std::size_t k = 1;
+  while (k <= n) {
+    k = 2 * k + (start_tree_[k] <= address);
+  }
+  // Undo the trailing right turns to recover the node where the search last went left
+  k >>= __builtin_ffsll(~k);
 
-      symbol_addr_map_.insert({ addr_range, &symbol });
+  auto upper_bound = k == 0 ? n : start_tree_index_[k];
+  return upper_bound == 0 ? std::string::npos : upper_bound - 1;
+}
+
+std::optional<const Elf64_Sym*> sdb::elf_image::symbol_containing(std::size_t index, std::uint64_t address) const {
+  if (index == std::string::npos) return std::nullopt;
+
+  // Zero-sized symbols only match their exact address
+  if (symbol_starts_[index] == address or address < symbol_ends_[index]) {
+    return &symbol_table_[symbols_by_start_[index]];
+  }
+
+  return std::nullopt;
+}
+
+void sdb::elf_image::build_name_index() const {
+  constexpr std::size_t symbols_per_worker = 4096;
+
+  struct demangled_name {
+    std::size_t symbol;
+    std::size_t offset;
+    std::size_t size;
+  };
+  struct slice {
+    std::string names;
+    std::vector<demangled_name> entries;
+  };
+
+  // Each worker demangles a contiguous slice of the table into its own buffer
+  auto n_workers = std::clamp<std::size_t>(
+    symbol_table_.size() / symbols_per_worker, 1, std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<slice> slices(n_workers);
+
+  auto demangle_slice = [&](std::size_t index) {
+    auto& out = slices[index];
+    auto first = symbol_table_.size() * index / n_workers;
+    auto last = symbol_table_.size() * (index + 1) / n_workers;
+
+    // __cxa_demangle writes into this buffer when the result fits and reallocates it otherwise
+    char* buffer = nullptr;
+    std::size_t capacity = 0;
+
+    for (auto i = first; i < last; ++i) {
+      auto mangled_name = string_at(symbol_table_[i].st_name);
+      // Without this check plain C names such as "i" would be demangled as types
+      if (mangled_name.substr(0, 2) != "_Z") continue;
+
+      int demangle_status;
+      auto result = abi::__cxa_demangle(mangled_name.data(), buffer, &capacity, &demangle_status);
+      if (demangle_status != 0) continue;
+
+      buffer = result;
+      std::string_view name = result;
+      out.entries.push_back({ i, out.names.size(), name.size() });
+      out.names += name;
+      out.names += '\0';
     }
+
+    free(buffer);
+  };
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < n_workers; ++i) {
+    workers.emplace_back(demangle_slice, i);
+  }
+  demangle_slice(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  auto& arena = built_indexes_.demangled_names;
+  auto& entries = built_indexes_.name_entries;
+
+  for (std::size_t i = 0; i < symbol_table_.size(); ++i) {
+    auto name = string_at(symbol_table_[i].st_name);
+    if (name.empty()) continue;
+    entries.push_back({ static_cast<std::uint32_t>(i), 0, symbol_table_[i].st_name, static_cast<std::uint32_t>(name.size()) });
+  }
+
+  for (auto& part : slices) {
+    auto base = arena.size();
+    arena.insert(arena.end(), part.names.begin(), part.names.end());
+    for (auto& entry : part.entries) {
+      entries.push_back({
+        static_cast<std::uint32_t>(entry.symbol), 1,
+        static_cast<std::uint32_t>(base + entry.offset), static_cast<std::uint32_t>(entry.size)
+      });
+    }
+  }
+
+  // At most half full, so probe sequences stay short
+  std::size_t n_buckets = 1;
+  while (n_buckets < 2 * entries.size()) n_buckets *= 2;
+  auto& buckets = built_indexes_.name_buckets;
+  buckets.assign(n_buckets, 0);
+
+  demangled_names_ = arena;
+  name_entries_ = entries;
+
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    auto hash = hash_name(entry_name(entries[i]));
+    auto slot = hash & (n_buckets - 1);
+    while (buckets[slot] != 0) slot = (slot + 1) & (n_buckets - 1);
+    buckets[slot] = (hash << 32) | (i + 1);
+  }
+  name_buckets_ = buckets;
+  name_index_ready_ = true;
+
+  save_cached_indexes();
+}
+
+std::string_view sdb::elf_image::entry_name(const name_entry& entry) const {
+  if (entry.in_arena) return { demangled_names_.begin() + entry.offset, entry.size };
+  return { string_table_ + entry.offset, entry.size };
+}
+
+sdb::elf::elf(const std::filesystem::path& path, bool decompress_in_background)
+  : image_(elf_image::open(path)), path_(path) {
+  if (decompress_in_background) image_->prefetch_compressed_sections();
+}
+
+const Elf64_Shdr* sdb::elf::get_section_containing_address(file_addr addr) const {
+  if (addr.elf_file() != this) return nullptr;
+  return image_->get_section_containing_address(addr.addr());
+}
+
+const Elf64_Shdr* sdb::elf::get_section_containing_address(virt_addr addr) const {
+  if (addr < load_bias_) return nullptr;
+  return image_->get_section_containing_address(addr.addr() - load_bias_.addr());
+}
+
+const Elf64_Phdr* sdb::elf::get_segment_containing_address(file_addr addr) const {
+  if (addr.elf_file() != this) return nullptr;
+  return image_->get_segment_containing_address(addr.addr());
+}
+
+std::optional<std::uint64_t> sdb::elf::get_file_offset(file_addr addr) const {
+  if (addr.elf_file() != this) return std::nullopt;
+  return image_->get_file_offset(addr.addr());
+}
+
+std::optional<sdb::file_addr> sdb::elf::get_file_addr(std::uint64_t offset) const {
+  if (auto address = image_->get_file_addr(offset)) return file_addr{ *this, *address };
+  return std::nullopt;
+}
+
+std::optional<sdb::span<const std::byte>> sdb::elf::get_bytes(file_addr address, std::size_t size) const {
+  if (address.elf_file() != this) return std::nullopt;
+  return image_->get_bytes(address.addr(), size);
+}
+
+std::optional<sdb::file_addr> sdb::elf::get_section_start_address(std::string_view name) const {
+  if (auto sect = get_section(name); sect) {
+    return file_addr{ *this, sect.value()->sh_addr };
+  }
+
+  return std::nullopt;
+}
+
+std::optional<const Elf64_Sym*> sdb::elf::get_symbol_at_address(file_addr address) const {
+  if (address.elf_file() != this) return std::nullopt;
+  return image_->get_symbol_at_address(address.addr());
+}
+
+std::optional<const Elf64_Sym*> sdb::elf::get_symbol_at_address(virt_addr address) const {
+  return get_symbol_at_address(address.to_file_addr(*this));
+}
+
+std::optional<const Elf64_Sym*> sdb::elf::get_symbol_containing_address(file_addr address) const {
+  if (address.elf_file() != this) return std::nullopt;
+  return image_->get_symbol_containing_address(address.addr());
+}
+
+std::optional<const Elf64_Sym*> sdb::elf::get_symbol_containing_address(virt_addr address) const {
+  return get_symbol_containing_address(address.to_file_addr(*this));
+}
+
+std::vector<std::optional<const Elf64_Sym*>> sdb::elf::symbolize(span<const virt_addr> addresses) const {
+  std::vector<std::uint64_t> file_addresses;
+  file_addresses.reserve(addresses.size());
+  for (auto& address : addresses) {
+    file_addresses.push_back(address.addr() - load_bias_.addr());
   }
+  return image_->symbolize(file_addresses);
 }
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstring>
+#include <libsdb/error.hpp>
+#include <libsdb/execution_log.hpp>
+
+namespace {
+  constexpr std::size_t n_gpr_words = sizeof(user_regs_struct) / sizeof(std::uint64_t);
+  constexpr std::size_t n_fpr_words = sizeof(user_fpregs_struct) / sizeof(std::uint64_t);
+  static_assert(n_gpr_words <= 32 and n_fpr_words <= 64, "register masks are too narrow");
+
+  template <std::size_t N, class Mask>
+  Mask diff_words(const void* before, const void* after, std::uint64_t* changed, std::size_t& n_changed) {
+    Mask mask = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+      std::uint64_t old_word, new_word;
+      std::memcpy(&old_word, static_cast<const std::byte*>(before) + i * 8, 8);
+      std::memcpy(&new_word, static_cast<const std::byte*>(after) + i * 8, 8);
+      if (old_word != new_word) {
+        mask |= Mask(1) << i;
+        changed[n_changed++] = old_word;
+      }
+    }
+    return mask;
+  }
+}
+
+sdb::execution_log::execution_log(std::size_t capacity)
+  // Deliberately left uninitialized so pages are only committed once used
+  : data_(new std::byte[capacity]), capacity_(capacity) {}
+
+void sdb::execution_log::write_bytes(std::size_t pos, const void* src, std::size_t size) {
+  auto bytes = static_cast<const std::byte*>(src);
+  pos %= capacity_;
+  auto first = std::min(size, capacity_ - pos);
+  std::copy(bytes, bytes + first, data_.get() + pos);
+  std::copy(bytes + first, bytes + size, data_.get());
+}
+
+void sdb::execution_log::read_bytes(std::size_t pos, void* dest, std::size_t size) const {
+  auto bytes = static_cast<std::byte*>(dest);
+  pos %= capacity_;
+  auto first = std::min(size, capacity_ - pos);
+  std::copy(data_.get() + pos, data_.get() + pos + first, bytes);
+  std::copy(data_.get(), data_.get() + (size - first), bytes + first);
+}
+
+void sdb::execution_log::evict_oldest() {
+  auto tail = (head_ + capacity_ - used_) % capacity_;
+  size_field size;
+  read_bytes(tail, &size, sizeof(size));
+  used_ -= size;
+  --n_entries_;
+}
+
+/*
+  Entry layout:
+    u32 size, u32 gpr mask, u64 fpr mask, u64 old words...,
+    u32 write count, { u64 address, u32 size, bytes... }..., u32 size
+*/
+void sdb::execution_log::push(
+  const user_regs_struct& gprs_before, const user_fpregs_struct& fprs_before,
+  const user_regs_struct& gprs_after, const user_fpregs_struct& fprs_after,
+  const std::vector<memory_write>& writes) {
+  std::uint64_t changed[n_gpr_words + n_fpr_words];
+  std::size_t n_changed = 0;
+  auto gpr_mask = diff_words<n_gpr_words, std::uint32_t>(&gprs_before, &gprs_after, changed, n_changed);
+  auto fpr_mask = diff_words<n_fpr_words, std::uint64_t>(&fprs_before, &fprs_after, changed, n_changed);
+
+  std::size_t size = 2 * sizeof(size_field) + sizeof(gpr_mask) + sizeof(fpr_mask) +
+    n_changed * sizeof(std::uint64_t) + sizeof(std::uint32_t);
+  for (auto& write : writes) {
+    size += sizeof(std::uint64_t) + sizeof(std::uint32_t) + write.old_data.size();
+  }
+
+  if (size > capacity_) {
+    error::send("Instruction is too large to record");
+  }
+  while (capacity_ - used_ < size) evict_oldest();
+
+  auto pos = head_;
+  auto put = [&](const void* src, std::size_t n) {
+    write_bytes(pos, src, n);
+    pos += n;
+  };
+
+  auto size_value = static_cast<size_field>(size);
+  put(&size_value, sizeof(size_value));
+  put(&gpr_mask, sizeof(gpr_mask));
+  put(&fpr_mask, sizeof(fpr_mask));
+  put(changed, n_changed * sizeof(std::uint64_t));
+
+  auto n_writes = static_cast<std::uint32_t>(writes.size());
+  put(&n_writes, sizeof(n_writes));
+  for (auto& write : writes) {
+    auto address = write.address.addr();
+    auto write_size = static_cast<std::uint32_t>(write.old_data.size());
+    put(&address, sizeof(address));
+    put(&write_size, sizeof(write_size));
+    put(write.old_data.data(), write_size);
+  }
+  put(&size_value, sizeof(size_value));
+
+  head_ = pos % capacity_;
+  used_ += size;
+  ++n_entries_;
+}
+
+std::vector<sdb::execution_log::memory_write> sdb::execution_log::pop(
+  user_regs_struct& gprs, user_fpregs_struct& fprs) {
+  if (empty()) {
+    error::send("Execution log is empty");
+  }
+
+  size_field size;
+  read_bytes(head_ + capacity_ - sizeof(size), &size, sizeof(size));
+  auto start = head_ + capacity_ - size;
+
+  auto pos = start + sizeof(size_field);
+  auto get = [&](void* dest, std::size_t n) {
+    read_bytes(pos, dest, n);
+    pos += n;
+  };
+
+  std::uint32_t gpr_mask;
+  std::uint64_t fpr_mask;
+  get(&gpr_mask, sizeof(gpr_mask));
+  get(&fpr_mask, sizeof(fpr_mask));
+
+  auto restore = [&](void* regs, std::uint64_t mask, std::size_t n_words) {
+    for (std::size_t i = 0; i < n_words; ++i) {
+      if (mask & (std::uint64_t(1) << i)) {
+        get(static_cast<std::byte*>(regs) + i * 8, 8);
+      }
+    }
+  };
+  restore(&gprs, gpr_mask, n_gpr_words);
+  restore(&fprs, fpr_mask, n_fpr_words);
+
+  std::uint32_t n_writes;
+  get(&n_writes, sizeof(n_writes));
+
+  std::vector<memory_write> writes(n_writes);
+  for (auto& write : writes) {
+    std::uint64_t address;
+    std::uint32_t write_size;
+    get(&address, sizeof(address));
+    get(&write_size, sizeof(write_size));
+    write.address = virt_addr{ address };
+    write.old_data.resize(write_size);
+    get(write.old_data.data(), write_size);
+  }
+
+  head_ = start % capacity_;
+  used_ -= size;
+  --n_entries_;
+  return writes;
+}
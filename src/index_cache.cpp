@@ -0,0 +1,151 @@
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libsdb/bit.hpp>
+#include <libsdb/index_cache.hpp>
+
+namespace {
+  constexpr char cache_magic[8] = { 'S', 'D', 'B', 'I', 'N', 'D', 'E', 'X' };
+
+  struct file_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n_blobs;
+  };
+
+  struct blob_header {
+    std::uint32_t tag;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  std::uint64_t align8(std::uint64_t n) {
+    return (n + 7) & ~std::uint64_t(7);
+  }
+
+  std::filesystem::path cache_file(std::string_view key) {
+    auto dir = sdb::index_cache::directory();
+    if (dir.empty()) return {};
+    return dir / (std::string(key) + ".idx");
+  }
+}
+
+std::filesystem::path sdb::index_cache::directory() {
+  if (auto xdg = std::getenv("XDG_CACHE_HOME"); xdg and *xdg) {
+    return std::filesystem::path(xdg) / "sdb";
+  }
+  if (auto home = std::getenv("HOME"); home and *home) {
+    return std::filesystem::path(home) / ".cache" / "sdb";
+  }
+  return {};
+}
+
+std::unique_ptr<sdb::index_cache> sdb::index_cache::load(std::string_view key) {
+  auto path = cache_file(key);
+  if (path.empty()) return nullptr;
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+
+  struct stat stats;
+  if (fstat(fd, &stats) < 0 or static_cast<std::size_t>(stats.st_size) < sizeof(file_header)) {
+    close(fd);
+    return nullptr;
+  }
+
+  std::size_t size = stats.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+  if (data == MAP_FAILED) return nullptr;
+
+  std::unique_ptr<index_cache> ret(new index_cache(static_cast<std::byte*>(data), size));
+
+  auto header = from_bytes<file_header>(ret->data_);
+  if (!std::equal(header.magic, header.magic + sizeof(header.magic), cache_magic) or
+      header.version != version or
+      header.n_blobs > (size - sizeof(file_header)) / sizeof(blob_header)) {
+    return nullptr;
+  }
+
+  for (std::uint32_t i = 0; i < header.n_blobs; ++i) {
+    auto blob = from_bytes<blob_header>(ret->data_ + sizeof(file_header) + i * sizeof(blob_header));
+    if (blob.offset > size or blob.size > size - blob.offset) return nullptr;
+  }
+
+  return ret;
+}
+
+sdb::index_cache::~index_cache() {
+  munmap(data_, size_);
+}
+
+std::optional<sdb::span<const std::byte>> sdb::index_cache::get(tag id) const {
+  auto header = from_bytes<file_header>(data_);
+  for (std::uint32_t i = 0; i < header.n_blobs; ++i) {
+    auto blob = from_bytes<blob_header>(data_ + sizeof(file_header) + i * sizeof(blob_header));
+    if (blob.tag == static_cast<std::uint32_t>(id)) {
+      return span<const std::byte>{ data_ + blob.offset, blob.size };
+    }
+  }
+  return std::nullopt;
+}
+
+void sdb::index_cache::writer::add(tag id, span<const std::byte> data) {
+  blobs_.emplace_back(id, std::vector<std::byte>(data.begin(), data.end()));
+}
+
+bool sdb::index_cache::writer::commit(std::string_view key) const {
+  auto path = cache_file(key);
+  if (path.empty()) return false;
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  if (ec) return false;
+
+  // Written under a temporary name and renamed so readers never see a partial file
+  auto temp_path = path;
+  temp_path += ".tmp." + std::to_string(getpid());
+
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    file_header header{};
+    std::copy(cache_magic, cache_magic + sizeof(cache_magic), header.magic);
+    header.version = version;
+    header.n_blobs = blobs_.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    auto offset = align8(sizeof(file_header) + blobs_.size() * sizeof(blob_header));
+    for (auto& [id, data] : blobs_) {
+      blob_header blob{ static_cast<std::uint32_t>(id), 0, offset, data.size() };
+      out.write(reinterpret_cast<const char*>(&blob), sizeof(blob));
+      offset = align8(offset + data.size());
+    }
+
+    constexpr char padding[8] = {};
+    std::uint64_t written = sizeof(file_header) + blobs_.size() * sizeof(blob_header);
+    for (auto& [id, data] : blobs_) {
+      out.write(padding, align8(written) - written);
+      out.write(reinterpret_cast<const char*>(data.data()), data.size());
+      written = align8(written) + data.size();
+    }
+
+    if (!out) {
+      std::filesystem::remove(temp_path, ec);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  return true;
+}
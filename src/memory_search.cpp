@@ -0,0 +1,93 @@
+#include <cstring>
+#include <immintrin.h>
+#include <libsdb/memory_search.hpp>
+
+namespace {
+  using search_fn = void (*)(const std::byte*, std::size_t, const std::byte*, std::size_t, std::size_t, std::vector<std::size_t>&);
+
+  bool matches_at(const std::byte* haystack, std::size_t pos, const std::byte* needle, std::size_t needle_size) {
+    // The first and last bytes have already been compared
+    return needle_size <= 2 or std::memcmp(haystack + pos + 1, needle + 1, needle_size - 2) == 0;
+  }
+
+  void find_scalar(
+    const std::byte* haystack, std::size_t from, std::size_t size,
+    const std::byte* needle, std::size_t needle_size,
+    std::size_t search_end, std::vector<std::size_t>& out) {
+    auto last = needle[needle_size - 1];
+    for (auto pos = from; pos + needle_size <= size and pos < search_end; ++pos) {
+      if (haystack[pos] == needle[0] and haystack[pos + needle_size - 1] == last and
+          matches_at(haystack, pos, needle, needle_size)) {
+        out.push_back(pos);
+      }
+    }
+  }
+
+  // Tests 16 candidate positions per iteration
+  void find_sse2(
+    const std::byte* haystack, std::size_t size, const std::byte* needle, std::size_t needle_size,
+    std::size_t search_end, std::vector<std::size_t>& out) {
+    auto first = _mm_set1_epi8(static_cast<char>(needle[0]));
+    auto last = _mm_set1_epi8(static_cast<char>(needle[needle_size - 1]));
+
+    std::size_t pos = 0;
+    for (; pos + needle_size - 1 + 16 <= size and pos < search_end; pos += 16) {
+      auto block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + pos));
+      auto block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + pos + needle_size - 1));
+      unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+
+      while (mask) {
+        auto candidate = pos + __builtin_ctz(mask);
+        if (candidate < search_end and matches_at(haystack, candidate, needle, needle_size)) {
+          out.push_back(candidate);
+        }
+        mask &= mask - 1;
+      }
+    }
+
+    find_scalar(haystack, pos, size, needle, needle_size, search_end, out);
+  }
+
+  // Tests 32 candidate positions per iteration
+  __attribute__((target("avx2")))
+  void find_avx2(
+    const std::byte* haystack, std::size_t size, const std::byte* needle, std::size_t needle_size,
+    std::size_t search_end, std::vector<std::size_t>& out) {
+    auto first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+    auto last = _mm256_set1_epi8(static_cast<char>(needle[needle_size - 1]));
+
+    std::size_t pos = 0;
+    for (; pos + needle_size - 1 + 32 <= size and pos < search_end; pos += 32) {
+      auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + pos));
+      auto block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + pos + needle_size - 1));
+      unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+
+      while (mask) {
+        auto candidate = pos + __builtin_ctz(mask);
+        if (candidate < search_end and matches_at(haystack, candidate, needle, needle_size)) {
+          out.push_back(candidate);
+        }
+        mask &= mask - 1;
+      }
+    }
+
+    find_scalar(haystack, pos, size, needle, needle_size, search_end, out);
+  }
+
+  search_fn select_search() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? find_avx2 : find_sse2;
+  }
+}
+
+void sdb::find_all(
+  span<const std::byte> haystack, span<const std::byte> needle,
+  std::size_t search_end, std::vector<std::size_t>& out) {
+  if (needle.size() == 0 or haystack.size() < needle.size()) return;
+
+  static const search_fn search = select_search();
+  search(haystack.begin(), haystack.size(), needle.begin(), needle.size(),
+    std::min(search_end, haystack.size() - needle.size() + 1), out);
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <libsdb/memory_snapshot.hpp>
+#include <libsdb/process.hpp>
+
+namespace {
+  // read_memory uses one iovec per page, and process_vm_readv accepts at most IOV_MAX of them
+  constexpr std::size_t read_chunk_size = 1024 * 1024;
+
+  const std::byte zero_data[sdb::memory_snapshot::block_size] = {};
+
+  std::uint64_t hash_block(const std::byte* data) {
+    std::uint64_t hash = 0x9e3779b97f4a7c15;
+    for (std::size_t i = 0; i < sdb::memory_snapshot::block_size; i += sizeof(std::uint64_t)) {
+      std::uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * 0x9ddfea08eb382d69;
+      hash ^= hash >> 47;
+    }
+    return hash;
+  }
+}
+
+sdb::memory_snapshot sdb::memory_snapshot::take(const process& proc, const std::vector<address_range>& ranges) {
+  static_assert(read_chunk_size % block_size == 0);
+
+  memory_snapshot ret;
+  for (auto& range : ranges) {
+    ret.ranges_.push_back(range);
+    auto& ids = ret.block_ids_.emplace_back();
+
+    auto size = range.end.addr() - range.start.addr();
+    ids.reserve((size + block_size - 1) / block_size);
+
+    for (std::size_t done = 0; done < size; done += read_chunk_size) {
+      auto amount = std::min<std::size_t>(read_chunk_size, size - done);
+      auto data = proc.read_memory_without_traps(range.start + done, amount);
+
+      for (std::size_t offset = 0; offset < amount; offset += block_size) {
+        ids.push_back(ret.store_block(data.data() + offset, std::min(block_size, amount - offset)));
+      }
+    }
+  }
+
+  return ret;
+}
+
+std::uint32_t sdb::memory_snapshot::store_block(const std::byte* data, std::size_t size) {
+  std::byte padded[block_size];
+  if (size < block_size) {
+    std::copy_n(data, size, padded);
+    std::fill(padded + size, padded + block_size, std::byte{ 0 });
+    data = padded;
+  }
+
+  if (std::memcmp(data, zero_data, block_size) == 0) return zero_block;
+
+  auto hash = hash_block(data);
+  auto [first, last] = blocks_by_hash_.equal_range(hash);
+  for (auto it = first; it != last; ++it) {
+    if (std::memcmp(block_data(it->second), data, block_size) == 0) return it->second;
+  }
+
+  if (n_blocks_ % blocks_per_slab == 0) {
+    slabs_.push_back(std::make_unique<std::byte[]>(blocks_per_slab * block_size));
+  }
+  auto id = static_cast<std::uint32_t>(n_blocks_++);
+  std::copy_n(data, block_size, slabs_.back().get() + (id % blocks_per_slab) * block_size);
+  blocks_by_hash_.emplace(hash, id);
+  return id;
+}
+
+const std::byte* sdb::memory_snapshot::block_data(std::uint32_t id) const {
+  if (id == zero_block) return zero_data;
+  return slabs_[id / blocks_per_slab].get() + (id % blocks_per_slab) * block_size;
+}
+
+std::size_t sdb::memory_snapshot::size() const {
+  std::size_t ret = 0;
+  for (auto& range : ranges_) {
+    ret += range.end.addr() - range.start.addr();
+  }
+  return ret;
+}
+
+std::vector<sdb::memory_snapshot::change> sdb::memory_snapshot::diff(const process& proc) const {
+  std::vector<change> ret;
+
+  for (std::size_t r = 0; r < ranges_.size(); ++r) {
+    auto& range = ranges_[r];
+    auto size = range.end.addr() - range.start.addr();
+
+    // Whether ret.back() is a run that is still being extended
+    bool in_run = false;
+    auto differ = [&](std::size_t offset, std::byte old_byte, std::byte new_byte) {
+      if (!in_run) {
+        ret.push_back({ range.start + offset, {}, {} });
+        in_run = true;
+      }
+      ret.back().old_data.push_back(old_byte);
+      ret.back().new_data.push_back(new_byte);
+    };
+
+    for (std::size_t done = 0; done < size; done += read_chunk_size) {
+      auto amount = std::min<std::size_t>(read_chunk_size, size - done);
+      auto current = proc.read_memory_without_traps(range.start + done, amount);
+
+      for (std::size_t offset = 0; offset < amount; offset += block_size) {
+        auto old_data = block_data(block_ids_[r][(done + offset) / block_size]);
+        auto new_data = current.data() + offset;
+        auto n = std::min(block_size, amount - offset);
+        auto base = done + offset;
+
+        // Compare 16 bytes at a time, only looking at individual bytes when something changed
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+          auto lhs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(old_data + i));
+          auto rhs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(new_data + i));
+          unsigned changed = ~_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs)) & 0xffff;
+
+          if (changed == 0) {
+            in_run = false;
+            continue;
+          }
+          for (std::size_t j = 0; j < 16; ++j) {
+            if (changed & (1u << j)) {
+              differ(base + i + j, old_data[i + j], new_data[i + j]);
+            } else {
+              in_run = false;
+            }
+          }
+        }
+
+        for (; i < n; ++i) {
+          if (old_data[i] != new_data[i]) {
+            differ(base + i, old_data[i], new_data[i]);
+          } else {
+            in_run = false;
+          }
+        }
+      }
+    }
+  }
+
+  return ret;
+}
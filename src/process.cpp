@@ -1,23 +1,101 @@
 #include <libsdb/bit.hpp>
+#include <libsdb/core_file.hpp>
+#include <libsdb/disassembler.hpp>
 #include <libsdb/error.hpp>
 #include <libsdb/process.hpp>
-#include <libsdb/pipe.hpp>
 
+#include <atomic>
 #include <elf.h>
+#include <fcntl.h>
 #include <fstream>
 #include <memory>
+#include <sched.h>
+#include <signal.h>
+#include <sstream>
 #include <sys/personality.h>
+#include <sys/procfs.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
+#include <thread>
 #include <unistd.h>
 
 namespace {
-  void exit_with_perror(sdb::pipe& channel, std::string const& prefix) {
-    auto message = prefix + ": " + std::strerror(errno);
-    channel.write(reinterpret_cast<std::byte*>(message.data()), message.size());
-    exit(-1);
+  struct launch_request {
+    const char* path;
+    char** argv;
+    char** envp;
+    const char* working_directory;
+    const sdb::launch_options::redirection* redirections;
+    std::size_t n_redirections;
+    bool debug;
+    sigset_t signal_mask;
+
+    // Written by the child if a step before exec fails
+    const char* failed_step = nullptr;
+    int failed_errno = 0;
+  };
+
+  // Runs in the child of clone(CLONE_VM | CLONE_VFORK), so only async-signal-safe calls are allowed
+  int launch_child(void* arg) {
+    auto& request = *static_cast<launch_request*>(arg);
+    auto fail = [&](const char* step) {
+      request.failed_step = step;
+      request.failed_errno = errno;
+      _exit(127);
+    };
+
+    // Handlers installed by sdb must not run in the child
+    for (int sig = 1; sig < NSIG; ++sig) {
+      struct sigaction action;
+      if (sigaction(sig, nullptr, &action) == 0 and action.sa_handler != SIG_IGN and action.sa_handler != SIG_DFL) {
+        action.sa_handler = SIG_DFL;
+        sigaction(sig, &action, nullptr);
+      }
+    }
+    sigprocmask(SIG_SETMASK, &request.signal_mask, nullptr);
+
+    if (setpgid(0, 0) < 0) fail("Could not set pgid");
+    personality(ADDR_NO_RANDOMIZE);
+
+    if (request.working_directory and chdir(request.working_directory) < 0) {
+      fail("Could not change working directory");
+    }
+
+    for (std::size_t i = 0; i < request.n_redirections; ++i) {
+      if (dup2(request.redirections[i].from, request.redirections[i].to) < 0) {
+        fail("fd redirection failed");
+      }
+    }
+
+    if (request.debug and ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0) {
+      fail("tracing failed");
+    }
+
+    execve(request.path, request.argv, request.envp);
+    fail("exec failed");
+    return 127;
+  }
+
+  // Searches PATH the way execlp does, but in the parent so the child doesn't have to allocate
+  std::filesystem::path resolve_executable(const std::filesystem::path& path) {
+    if (path.native().find('/') != std::string::npos) return path;
+
+    auto path_env = std::getenv("PATH");
+    std::string_view dirs = path_env ? path_env : "/bin:/usr/bin";
+    while (true) {
+      auto split = dirs.find(':');
+      auto dir = dirs.substr(0, split);
+      auto candidate = std::filesystem::path(dir.empty() ? "." : std::string(dir)) / path;
+      if (access(candidate.c_str(), X_OK) == 0) return candidate;
+
+      if (split == std::string_view::npos) break;
+      dirs.remove_prefix(split + 1);
+    }
+
+    return path;
   }
 
   void set_ptrace_options(pid_t pid) {
@@ -45,6 +123,174 @@ namespace {
     }
   }
 
+  // Field 4 of /proc/pid/stat. The command name before it may hold spaces and parentheses,
+  // so fields are counted from the last ')'.
+  pid_t read_parent_pid(pid_t pid) {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    std::getline(stat, line);
+
+    auto name_end = line.rfind(')');
+    if (name_end == std::string::npos) return 0;
+
+    std::istringstream fields(line.substr(name_end + 1));
+    char state;
+    pid_t ppid = 0;
+    fields >> state >> ppid;
+    return ppid;
+  }
+
+  void append_core_note(std::vector<std::byte>& notes, std::uint32_t type, const void* desc, std::size_t size) {
+    auto align4 = [](std::size_t n) { return (n + 3) & ~std::size_t(3); };
+    const char name[] = "CORE";
+
+    Elf64_Nhdr header{ sizeof(name), static_cast<Elf64_Word>(size), type };
+    auto start = notes.size();
+    notes.resize(start + sizeof(header) + align4(sizeof(name)) + align4(size));
+
+    auto pos = notes.data() + start;
+    std::memcpy(pos, &header, sizeof(header));
+    std::memcpy(pos + sizeof(header), name, sizeof(name));
+    std::memcpy(pos + sizeof(header) + align4(sizeof(name)), desc, size);
+  }
+
+  void write_all(int fd, const std::byte* data, std::size_t size, std::uint64_t offset) {
+    while (size > 0) {
+      auto written = pwrite(fd, data, size, offset);
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        sdb::error::send_errno("Could not write core file");
+      }
+      data += written;
+      offset += written;
+      size -= written;
+    }
+  }
+
+  bool is_zero_page(const std::byte* page, std::size_t size) {
+    // Word-sized OR reduction, which the compiler vectorizes
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < size; i += sizeof(std::uint64_t)) {
+      acc |= sdb::from_bytes<std::uint64_t>(page + i);
+    }
+    return acc == 0;
+  }
+
+  /*
+    Runs one syscall in a ptrace-stopped process by placing a syscall instruction at its PC,
+    then restores the overwritten code and the registers. Signals that arrive meanwhile are
+    discarded, as process::resume would. For fork, the child is returned through forked_child
+    in its initial ptrace stop, with the same code and registers restored.
+  */
+  std::int64_t run_injected_syscall(
+    pid_t pid, std::uint64_t number, const std::array<std::uint64_t, 6>& args, pid_t* forked_child = nullptr) {
+    user_regs_struct saved_regs;
+    user_fpregs_struct saved_fprs;
+    if (ptrace(PTRACE_GETREGS, pid, nullptr, &saved_regs) < 0 or
+        ptrace(PTRACE_GETFPREGS, pid, nullptr, &saved_fprs) < 0) {
+      sdb::error::send_errno("Could not save registers for syscall");
+    }
+
+    errno = 0;
+    std::uint64_t saved_code = ptrace(PTRACE_PEEKDATA, pid, saved_regs.rip, nullptr);
+    if (errno != 0) {
+      sdb::error::send_errno("Could not save code for syscall");
+    }
+
+    auto restore = [&](pid_t target) {
+      if (ptrace(PTRACE_POKEDATA, target, saved_regs.rip, saved_code) < 0 or
+          ptrace(PTRACE_SETREGS, target, nullptr, &saved_regs) < 0 or
+          ptrace(PTRACE_SETFPREGS, target, nullptr, &saved_fprs) < 0 or
+          ptrace(PTRACE_SETOPTIONS, target, nullptr, PTRACE_O_TRACESYSGOOD) < 0) {
+        sdb::error::send_errno("Could not restore process after syscall");
+      }
+    };
+
+    // 0f 05 is the syscall instruction. orig_rax = -1 stops the kernel
+    // from treating the stop we are in as an interrupted syscall to restart.
+    std::uint64_t syscall_code = (saved_code & ~0xffffull) | 0x050f;
+    auto regs = saved_regs;
+    regs.rax = number;
+    regs.orig_rax = -1;
+    regs.rdi = args[0];
+    regs.rsi = args[1];
+    regs.rdx = args[2];
+    regs.r10 = args[3];
+    regs.r8 = args[4];
+    regs.r9 = args[5];
+
+    auto options = PTRACE_O_TRACESYSGOOD | (forked_child ? PTRACE_O_TRACEFORK : 0);
+    std::int64_t ret = 0;
+    pid_t child = 0;
+    try {
+      if (ptrace(PTRACE_SETOPTIONS, pid, nullptr, options) < 0 or
+          ptrace(PTRACE_POKEDATA, pid, saved_regs.rip, syscall_code) < 0 or
+          ptrace(PTRACE_SETREGS, pid, nullptr, &regs) < 0 or
+          ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr) < 0) {
+        sdb::error::send_errno("Could not inject syscall");
+      }
+
+      while (true) {
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+          sdb::error::send_errno("waitpid failed");
+        }
+        if (!WIFSTOPPED(status)) {
+          sdb::error::send("Process exited during injected syscall");
+        }
+
+        // A successful fork reports an event stop before the syscall returns
+        if (status >> 8 == (SIGTRAP | (PTRACE_EVENT_FORK << 8))) {
+          unsigned long message;
+          if (ptrace(PTRACE_GETEVENTMSG, pid, nullptr, &message) < 0) {
+            sdb::error::send_errno("Could not get forked pid");
+          }
+          child = message;
+        } else {
+          // Until the PC moves past the syscall instruction the stop was for a signal,
+          // or the kernel rewound the PC to restart the syscall; either way, step again
+          user_regs_struct current;
+          if (ptrace(PTRACE_GETREGS, pid, nullptr, &current) < 0) {
+            sdb::error::send_errno("Could not read registers");
+          }
+          if (current.rip == saved_regs.rip + 2) {
+            ret = current.rax;
+            break;
+          }
+        }
+
+        if (ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr) < 0) {
+          sdb::error::send_errno("Could not finish syscall");
+        }
+      }
+    } catch (...) {
+      restore(pid);
+      throw;
+    }
+
+    restore(pid);
+
+    if (forked_child) {
+      if (child == 0) {
+        sdb::error::send(std::string("Could not fork inferior: ") + std::strerror(-ret));
+      }
+
+      if (waitpid(child, nullptr, __WALL) < 0) {
+        sdb::error::send_errno("waitpid failed");
+      }
+      restore(child);
+      *forked_child = child;
+    }
+
+    return ret;
+  }
+
+  pid_t fork_stopped(pid_t pid) {
+    pid_t child;
+    run_injected_syscall(pid, SYS_fork, {}, &child);
+    return child;
+  }
+
   int find_free_stoppoint_register(std::uint64_t control_register) {
     for (auto i = 0; i < 4; ++i) {
       if ((control_register & (0b11 << (i * 2))) == 0) {
@@ -71,6 +317,8 @@ void sdb::process::clear_hardware_stoppoint(int index) {
 
 
 void sdb::process::write_memory(virt_addr address, span<const std::byte> data) {
+  ensure_live();
+
   std::size_t written = 0;
   while (written < data.size()) {
     auto remaining = data.size() - written;
@@ -100,6 +348,8 @@ void sdb::process::write_memory(virt_addr address, span<const std::byte> data) {
 }
 
 std::vector<std::byte> sdb::process::read_memory(virt_addr address, std::size_t amount) const {
+  if (core_) return core_->read_memory(address, amount);
+
   std::vector<std::byte> ret(amount);
 
   iovec local_desc{ ret.data(), ret.size() };
@@ -145,18 +395,222 @@ std::vector<std::byte> sdb::process::read_memory_without_traps(virt_addr address
   return memory;
 }
 
-sdb::stop_reason sdb::process::maybe_resume_from_syscall(const stop_reason& reason) {
-  if (syscall_catch_policy_.get_mode() == syscall_catch_policy::mode::some) {
-    auto& to_catch = syscall_catch_policy_.get_to_catch();
-    auto found = std::find(begin(to_catch), end(to_catch), reason.syscall_info->id);
+std::vector<sdb::virt_addr> sdb::process::find(
+  span<const std::byte> pattern, const std::vector<address_range>& ranges) const {
+  if (pattern.size() == 0) error::send("Search pattern is empty");
 
-    if (found == end(to_catch)) {
-      resume();
-      return wait_on_signal();
+  constexpr std::size_t page_size = 0x1000;
+  constexpr std::size_t chunk_size = 4 * 1024 * 1024;
+
+  // Core files are searched only where the segment contents were actually saved
+  std::vector<address_range> readable;
+  if (core_) {
+    for (auto& seg : core_->segments()) {
+      if (seg.flags & PF_R) readable.push_back({ seg.start, seg.start + seg.file_size });
+    }
+  } else {
+    for (auto& region : get_memory_regions()) {
+      if (!region.readable or region.path == "[vvar]" or region.path == "[vsyscall]") continue;
+      readable.push_back({ region.start, region.end });
     }
   }
 
-  return reason;
+  /*
+    Each task searches for matches starting in [start, end), reading up to pattern.size() - 1
+    bytes past end so that matches straddling two chunks of the same mapping are found
+    exactly once. Matches never span two mappings.
+  */
+  struct search_task {
+    virt_addr start;
+    virt_addr end;
+    virt_addr limit;
+  };
+  std::vector<search_task> tasks;
+
+  auto add_tasks = [&](virt_addr start, virt_addr end) {
+    for (auto pos = start; pos < end; pos += chunk_size) {
+      tasks.push_back({ pos, std::min(pos + chunk_size, end), end });
+    }
+  };
+  for (auto& region : readable) {
+    if (ranges.empty()) {
+      add_tasks(region.start, region.end);
+      continue;
+    }
+    for (auto& range : ranges) {
+      auto start = std::max(region.start, range.start);
+      auto end = std::min(region.end, range.end);
+      if (start < end) add_tasks(start, end);
+    }
+  }
+
+  // Breakpoint sites are collected up front since the workers can't safely walk the collection
+  std::vector<std::pair<virt_addr, std::byte>> traps;
+  breakpoint_sites_.for_each([&](auto& site) {
+    if (site.is_enabled() and !site.is_hardware()) {
+      traps.emplace_back(site.address(), site.saved_data_);
+    }
+  });
+  std::sort(begin(traps), end(traps), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+
+  auto read = [&](virt_addr address, std::byte* buffer, std::size_t amount) -> std::size_t {
+    if (core_) {
+      auto view = core_->view(address, amount);
+      if (!view) return 0;
+      std::copy(view->begin(), view->end(), buffer);
+      return amount;
+    }
+
+    iovec local_desc{ buffer, amount };
+    iovec remote_desc{ reinterpret_cast<void*>(address.addr()), amount };
+    auto ret = process_vm_readv(pid_, &local_desc, 1, &remote_desc, 1, 0);
+    return ret < 0 ? 0 : ret;
+  };
+
+  std::vector<std::vector<virt_addr>> task_results(tasks.size());
+  std::atomic<std::size_t> next_task = 0;
+
+  auto worker = [&] {
+    std::vector<std::byte> buffer(chunk_size + pattern.size() - 1);
+    std::vector<std::size_t> matches;
+
+    for (auto i = next_task++; i < tasks.size(); i = next_task++) {
+      auto& task = tasks[i];
+      auto pos = task.start;
+
+      while (pos < task.end) {
+        auto wanted = std::min<std::size_t>(
+          task.end.addr() - pos.addr() + pattern.size() - 1, task.limit.addr() - pos.addr());
+        auto amount = read(pos, buffer.data(), wanted);
+
+        if (amount == 0) {
+          // Skip the unreadable page and try again from the next one
+          pos = virt_addr{ (pos.addr() + page_size) & ~(page_size - 1) };
+          continue;
+        }
+
+        auto trap = std::lower_bound(begin(traps), end(traps), pos, [](auto& entry, auto addr) {
+          return entry.first < addr;
+        });
+        for (; trap != end(traps) and trap->first < pos + amount; ++trap) {
+          buffer[trap->first.addr() - pos.addr()] = trap->second;
+        }
+
+        matches.clear();
+        find_all({ buffer.data(), amount }, pattern, task.end.addr() - pos.addr(), matches);
+        for (auto offset : matches) {
+          task_results[i].push_back(pos + offset);
+        }
+
+        // Short reads stop at the first unreadable page, so resume after it
+        pos = amount == wanted ? task.end : pos + amount + page_size;
+      }
+    }
+  };
+
+  auto n_workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), tasks.size());
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < n_workers; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  // Tasks were created in address order, so concatenating them keeps the results sorted
+  std::vector<virt_addr> ret;
+  for (auto& results : task_results) {
+    ret.insert(end(ret), begin(results), end(results));
+  }
+  return ret;
+}
+
+bool sdb::process::should_resume_from_syscall(const stop_reason& reason) const {
+  switch (syscall_catch_policy_.get_mode()) {
+    // Syscall stops only happen under catch_none while they are being logged
+    case syscall_catch_policy::mode::none:
+      return true;
+    case syscall_catch_policy::mode::some: {
+      auto& to_catch = syscall_catch_policy_.get_to_catch();
+      return std::find(begin(to_catch), end(to_catch), reason.syscall_info->id) == end(to_catch);
+    }
+    default:
+      return false;
+  }
+}
+
+void sdb::process::handle_logged_syscall(stop_reason& reason) {
+  auto& info = *reason.syscall_info;
+
+  if (info.entry) {
+    current_syscall_ = info;
+    current_syscall_bound_ = syscall_log::entry_bound(*this, info.id, info.args);
+    replaying_current_syscall_ = false;
+
+    if (syscall_log_mode_ != syscall_log_mode::replay or !syscall_log::is_logged(info.id)) return;
+
+    // Past the end of the log the process just runs live
+    if (replay_position_ == syscall_log_.size()) {
+      syscall_log_mode_ = syscall_log_mode::off;
+      return;
+    }
+
+    auto& expected = syscall_log_.entries()[replay_position_];
+    if (expected.id != info.id) {
+      syscall_log_mode_ = syscall_log_mode::off;
+      error::send("Syscall replay diverged at entry " + std::to_string(replay_position_) +
+        ": expected syscall " + std::to_string(expected.id) + ", got " + std::to_string(info.id));
+    }
+
+    // An orig_rax of -1 makes the kernel skip the syscall but still report its exit
+    get_registers().write_by_id(register_id::orig_rax, std::int64_t{ -1 });
+    replaying_current_syscall_ = true;
+    return;
+  }
+
+  info.id = current_syscall_.id;
+  if (!syscall_log::is_logged(info.id)) return;
+
+  if (syscall_log_mode_ == syscall_log_mode::record) {
+    syscall_log::entry logged{ info.id, info.ret, {} };
+    for (auto& range : syscall_log::output_ranges(*this, info.id, current_syscall_.args, current_syscall_bound_, info.ret)) {
+      logged.outputs.push_back(read_memory_without_traps(range.address, range.size));
+    }
+    syscall_log_.push(std::move(logged));
+  } else if (replaying_current_syscall_) {
+    auto& logged = syscall_log_.entries()[replay_position_++];
+    auto ranges = syscall_log::output_ranges(*this, info.id, current_syscall_.args, current_syscall_bound_, logged.ret);
+    for (std::size_t i = 0; i < ranges.size() and i < logged.outputs.size(); ++i) {
+      auto& output = logged.outputs[i];
+      auto size = std::min(ranges[i].size, output.size());
+      write_memory(ranges[i].address, { output.data(), size });
+    }
+
+    get_registers().write_by_id(register_id::rax, static_cast<std::uint64_t>(logged.ret));
+    info.ret = logged.ret;
+    replaying_current_syscall_ = false;
+  }
+}
+
+void sdb::process::set_syscall_catch_policy(syscall_catch_policy info) {
+  if (info.get_mode() != syscall_catch_policy::mode::none) ensure_not_recording();
+  syscall_catch_policy_ = std::move(info);
+}
+
+void sdb::process::start_syscall_recording() {
+  ensure_live();
+  ensure_not_recording();
+  syscall_log_ = syscall_log{};
+  syscall_log_mode_ = syscall_log_mode::record;
+}
+
+void sdb::process::start_syscall_replay(syscall_log log) {
+  ensure_live();
+  ensure_not_recording();
+  syscall_log_ = std::move(log);
+  replay_position_ = 0;
+  syscall_log_mode_ = syscall_log_mode::replay;
 }
 
 // Constructor
@@ -174,6 +628,13 @@ sdb::stop_reason::stop_reason(int wait_status) {
 }
 
 sdb::stop_reason sdb::process::step_instruction() {
+  ensure_live();
+
+  if (execution_log_) return record_step();
+  return single_step();
+}
+
+sdb::stop_reason sdb::process::single_step() {
   std::optional<breakpoint_site*> to_reenable;
   auto pc = get_pc();
 
@@ -187,7 +648,8 @@ sdb::stop_reason sdb::process::step_instruction() {
     error::send_errno("Could not single step");
   }
 
-  auto reason = wait_on_signal();
+  // A single step is never resumed behind the caller's back
+  auto reason = wait_for_stop();
 
   if (to_reenable) {
     to_reenable.value()->enable();
@@ -226,6 +688,8 @@ int sdb::process::set_hardware_breakpoint(breakpoint_site::id_type id, virt_addr
 }
 
 sdb::breakpoint_site& sdb::process::create_breakpoint_site(virt_addr address, bool hardware, bool internal) {
+  ensure_live();
+
   if (breakpoint_sites_.contains_address(address)) {
     error::send("Breakpoint site already created at addres " + std::to_string(address.addr()));
   }
@@ -234,6 +698,23 @@ sdb::breakpoint_site& sdb::process::create_breakpoint_site(virt_addr address, bo
 }
 
 sdb::stop_reason sdb::process::wait_on_signal() {
+  while (true) {
+    auto reason = wait_for_stop();
+    if (!stop_handler_ or reason.reason != process_state::stopped or !stop_handler_(reason)) {
+      return reason;
+    }
+    resume();
+  }
+}
+
+sdb::stop_reason sdb::process::wait_for_stop() {
+  ensure_live();
+
+  // A recorded resume is carried out here, one logged instruction at a time
+  if (execution_log_ and state_ == process_state::running) {
+    return record_until_stop();
+  }
+
   int wait_status;
   int options = 0;
 
@@ -248,6 +729,26 @@ sdb::stop_reason sdb::process::wait_on_signal() {
     read_all_registers();
     augment_stop_reason(reason);
 
+    // Loop rather than recurse so that logging a long run of syscalls can't exhaust the stack
+    while (reason.trap_reason == trap_type::syscall) {
+      if (syscall_log_mode_ != syscall_log_mode::off or replaying_current_syscall_) {
+        handle_logged_syscall(reason);
+      }
+      if (!should_resume_from_syscall(reason)) break;
+
+      resume();
+      if (waitpid(pid_, &wait_status, options) < 0) {
+        error::send_errno("waitpid failed");
+      }
+
+      reason = stop_reason(wait_status);
+      state_ = reason.reason;
+      if (state_ != process_state::stopped) return reason;
+
+      read_all_registers();
+      augment_stop_reason(reason);
+    }
+
     // If we're at a breakpoint, in order to continue,
     // move the PC back one so it continues on a valid address
     auto instr_begin = get_pc() - 1;
@@ -262,8 +763,6 @@ sdb::stop_reason sdb::process::wait_on_signal() {
         if (id.index() == 1) {
           watchpoints_.get_by_id(std::get<1>(id)).update_data();
         }        
-      } else if (reason.trap_reason == trap_type::syscall) {
-        reason = maybe_resume_from_syscall(reason);
       }
     }
   }
@@ -276,43 +775,63 @@ std::unique_ptr<sdb::process> sdb::process::launch(
   bool debug,
   std::optional<int> stdout_replacement
 ) {
-  pipe channel(/*close_on_exec=*/true);
-  
-  pid_t pid;
-  if ((pid = fork()) < 0) {
-    error::send_errno("fork failed");
+  launch_options options;
+  if (stdout_replacement) {
+    options.redirections.push_back({ *stdout_replacement, STDOUT_FILENO });
   }
+  return launch(std::move(path), options, debug);
+}
 
-  if (pid == 0)  {
-    if (setpgid(0, 0) < 0) {
-      exit_with_perror(channel, "Could not set pgid");
-    }
-    personality(ADDR_NO_RANDOMIZE);
-    channel.close_read();
+std::unique_ptr<sdb::process> sdb::process::launch(
+  std::filesystem::path path,
+  const launch_options& options,
+  bool debug
+) {
+  // Everything the child touches is prepared up front, since it
+  // runs on sdb's memory and must not allocate or take locks
+  auto exec_path = resolve_executable(path);
+
+  std::vector<char*> argv;
+  argv.push_back(const_cast<char*>(path.c_str()));
+  for (auto& arg : options.args) argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  std::vector<char*> envp;
+  if (options.env) {
+    for (auto& var : *options.env) envp.push_back(const_cast<char*>(var.c_str()));
+    envp.push_back(nullptr);
+  }
 
-    if (stdout_replacement) {
-      if (dup2(*stdout_replacement, STDOUT_FILENO) < 0) {
-        exit_with_perror(channel, "stdout replacement failed");
-      }
-    }
-    
-    if (debug and ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0) {
-      exit_with_perror(channel, "tracing failed");
-    }
+  launch_request request{
+    exec_path.c_str(), argv.data(), options.env ? envp.data() : environ,
+    options.working_directory ? options.working_directory->c_str() : nullptr,
+    options.redirections.data(), options.redirections.size(), debug,
+    // Filled in below with the mask to restore in the child
+    sigset_t{}
+  };
 
-    if (execlp(path.c_str(), path.c_str(), nullptr) < 0) {
-      exit_with_perror(channel, "exec failed");
-    }
-  }
+  // Block signals so none of sdb's handlers run on the child while it shares our memory
+  sigset_t all_signals;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_SETMASK, &all_signals, &request.signal_mask);
+
+  std::vector<std::byte> stack(64 * 1024);
+  auto stack_top = reinterpret_cast<std::uintptr_t>(stack.data() + stack.size()) & ~std::uintptr_t(15);
 
-  channel.close_write();
-  auto data = channel.read();
-  channel.close_read();
+  // CLONE_VFORK suspends us until the child has exec'd or exited, so the child
+  // can share our address space instead of copying sdb's page tables
+  pid_t pid = clone(launch_child, reinterpret_cast<void*>(stack_top), CLONE_VM | CLONE_VFORK | SIGCHLD, &request);
+  auto clone_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &request.signal_mask, nullptr);
 
-  if (data.size() > 0) {
+  if (pid < 0) {
+    errno = clone_errno;
+    error::send_errno("clone failed");
+  }
+
+  if (request.failed_step) {
     waitpid(pid, nullptr, 0);
-    auto chars = reinterpret_cast<char*>(data.data());
-    error::send(std::string(chars, chars + data.size()));
+    error::send(std::string(request.failed_step) + ": " + std::strerror(request.failed_errno));
   }
 
   std::unique_ptr<process> proc (new process(pid, /*terminate_on_end=*/true, debug));
@@ -341,7 +860,38 @@ std::unique_ptr<sdb::process> sdb::process::attach(pid_t pid) {
   return proc;
 }
 
+std::unique_ptr<sdb::process> sdb::process::load_core(const std::filesystem::path& path) {
+  auto core = std::make_unique<core_file>(path);
+
+  std::unique_ptr<process> proc (new process(core->pid(), /*terminate_on_end=*/false, /*attached=*/false));
+  proc->get_registers().data_.regs = core->gprs();
+  proc->get_registers().data_.i387 = core->fprs();
+  proc->core_ = std::move(core);
+
+  return proc;
+}
+
+void sdb::process::ensure_live() const {
+  if (core_) {
+    error::send("Operation not supported on a core file");
+  }
+}
+
+void sdb::process::ensure_not_recording() const {
+  if (execution_log_) {
+    error::send("Syscalls can't be caught or logged while recording execution");
+  }
+}
+
 sdb::process::~process() {
+  // The pid stored in a core file may since have been reused by an unrelated process
+  if (core_) return;
+
+  for (auto& point : checkpoints_) {
+    kill(point.pid, SIGKILL);
+    waitpid(point.pid, nullptr, __WALL);
+  }
+
   if (pid_ != 0) {
     int status;
 
@@ -364,6 +914,13 @@ sdb::process::~process() {
 }
 
 void sdb::process::resume() {
+  ensure_live();
+
+  if (execution_log_) {
+    state_ = process_state::running;
+    return;
+  }
+
   auto pc = get_pc();
   if (breakpoint_sites_.enabled_stoppoint_at_address(pc)) {
     auto& bp = breakpoint_sites_.get_by_address(pc);
@@ -380,8 +937,8 @@ void sdb::process::resume() {
     bp.enable();
   }
 
-  auto request = syscall_catch_policy_.get_mode() == syscall_catch_policy::mode::none ?
-    PTRACE_CONT : PTRACE_SYSCALL;
+  auto request = syscall_catch_policy_.get_mode() == syscall_catch_policy::mode::none and
+    syscall_log_mode_ == syscall_log_mode::off ? PTRACE_CONT : PTRACE_SYSCALL;
   if (ptrace(request, pid_, nullptr, nullptr) < 0) {
     error::send_errno("Could not resume");
   }
@@ -389,6 +946,24 @@ void sdb::process::resume() {
   state_ = process_state::running;
 }
 
+void sdb::process::detach() {
+  ensure_live();
+
+  if (!is_attached_) return;
+
+  // A software breakpoint left in memory would kill the process with SIGTRAP once nobody is tracing it
+  breakpoint_sites_.for_each([](auto& site) {
+    if (site.is_enabled()) site.disable();
+  });
+
+  if (ptrace(PTRACE_DETACH, pid_, nullptr, nullptr) < 0) {
+    error::send_errno("Could not detach");
+  }
+
+  is_attached_ = false;
+  state_ = process_state::running;
+}
+
 void sdb::process::read_all_registers() {
   if (ptrace(PTRACE_GETREGS, pid_, nullptr, &get_registers().data_.regs) < 0) {
     error::send_errno("Could not read GPR registers");
@@ -412,18 +987,24 @@ void sdb::process::read_all_registers() {
 }
 
 void sdb::process::write_user_area(std::size_t offset, std::uint64_t data) {
+  ensure_live();
+
   if (ptrace(PTRACE_POKEUSER, pid_, offset, data) < 0) {
     error::send_errno("Could not write to user area");
   }
 }
 
 void sdb::process::write_fprs(const user_fpregs_struct& fprs) {
+  ensure_live();
+
   if (ptrace(PTRACE_SETFPREGS, pid_, nullptr, &fprs) < 0) {
     error::send_errno("Could not write floating point registers");
   }  
 }
 
 void sdb::process::write_gprs(const user_regs_struct& gprs) {
+  ensure_live();
+
   if (ptrace(PTRACE_SETREGS, pid_, nullptr, &gprs) < 0) {
     error::send_errno("Could not write general purpose registers");
   }  
@@ -472,6 +1053,8 @@ void sdb::process::augment_stop_reason(stop_reason& reason) {
   if (reason.info == SIGTRAP) {
     switch (info.si_code) {
       case TRAP_TRACE:
+      // Single-stepping over a syscall instruction is reported as TRAP_BRKPT on x86
+      case TRAP_BRKPT:
         reason.trap_reason = trap_type::single_step;
         break;
       case SI_KERNEL:
@@ -514,6 +1097,8 @@ int sdb::process::set_watchpoint(
 }
 
 sdb::watchpoint& sdb::process::create_watchpoint(virt_addr address, stoppoint_mode mode, std::size_t size) {
+  ensure_live();
+
   if (watchpoints_.contains_address(address)) {
     error::send("Watchpoint already created at address " + std::to_string(address.addr()));
   }
@@ -522,6 +1107,8 @@ sdb::watchpoint& sdb::process::create_watchpoint(virt_addr address, stoppoint_mo
 }
 
 std::unordered_map<int, std::uint64_t> sdb::process::get_auxv() const {
+  if (core_) return core_->auxv();
+
   auto path = "/proc/" + std::to_string(pid_) + "/auxv";
   std::ifstream auxv(path);
 
@@ -541,3 +1128,420 @@ std::unordered_map<int, std::uint64_t> sdb::process::get_auxv() const {
   return ret;
 }
 
+
+std::vector<sdb::memory_region> sdb::process::get_memory_regions() const {
+  if (core_) {
+    std::vector<memory_region> ret;
+    for (auto& seg : core_->segments()) {
+      ret.push_back({
+        seg.start, seg.end,
+        (seg.flags & PF_R) != 0, (seg.flags & PF_W) != 0, (seg.flags & PF_X) != 0,
+        /*shared=*/false, /*offset=*/0, /*path=*/""
+      });
+    }
+    return ret;
+  }
+
+  std::ifstream maps("/proc/" + std::to_string(pid_) + "/maps");
+  std::vector<memory_region> ret;
+
+  std::string line;
+  while (std::getline(maps, line)) {
+    std::istringstream fields(line);
+    std::string range, perms, offset, device, inode;
+    fields >> range >> perms >> offset >> device >> inode;
+
+    auto dash = range.find('-');
+    memory_region region;
+    region.start = virt_addr{ std::stoull(range.substr(0, dash), nullptr, 16) };
+    region.end = virt_addr{ std::stoull(range.substr(dash + 1), nullptr, 16) };
+    region.readable = perms[0] == 'r';
+    region.writable = perms[1] == 'w';
+    region.executable = perms[2] == 'x';
+    region.shared = perms[3] == 's';
+    region.offset = std::stoull(offset, nullptr, 16);
+    region.inode = std::stoull(inode);
+
+    std::getline(fields >> std::ws, region.path);
+    ret.push_back(std::move(region));
+  }
+
+  return ret;
+}
+
+void sdb::process::dump_core(const std::filesystem::path& path) const {
+  ensure_live();
+
+  constexpr std::size_t page_size = 0x1000;
+  constexpr std::size_t chunk_size = 4 * 1024 * 1024;
+
+  auto regions = get_memory_regions();
+  // vvar can't be read through /proc/pid/mem and vsyscall is not part of the address space proper
+  regions.erase(std::remove_if(begin(regions), end(regions), [](auto& region) {
+    return region.path == "[vvar]" or region.path == "[vsyscall]";
+  }), end(regions));
+
+  std::vector<std::byte> notes;
+
+  elf_prstatus status{};
+  siginfo_t info;
+  if (ptrace(PTRACE_GETSIGINFO, pid_, nullptr, &info) == 0) {
+    status.pr_cursig = info.si_signo;
+    status.pr_info.si_signo = info.si_signo;
+    status.pr_info.si_code = info.si_code;
+  }
+  status.pr_pid = pid_;
+  status.pr_ppid = read_parent_pid(pid_);
+  status.pr_pgrp = getpgid(pid_);
+  status.pr_sid = getsid(pid_);
+  static_assert(sizeof(status.pr_reg) == sizeof(user_regs_struct));
+  std::memcpy(&status.pr_reg, &registers_->data_.regs, sizeof(status.pr_reg));
+  status.pr_fpvalid = 1;
+  append_core_note(notes, NT_PRSTATUS, &status, sizeof(status));
+
+  elf_prpsinfo process_info{};
+  process_info.pr_pid = pid_;
+  process_info.pr_ppid = status.pr_ppid;
+  std::ifstream comm("/proc/" + std::to_string(pid_) + "/comm");
+  comm.getline(process_info.pr_fname, sizeof(process_info.pr_fname));
+  append_core_note(notes, NT_PRPSINFO, &process_info, sizeof(process_info));
+
+  append_core_note(notes, NT_FPREGSET, &registers_->data_.i387, sizeof(registers_->data_.i387));
+
+  std::vector<std::uint64_t> auxv;
+  for (auto [id, value] : get_auxv()) {
+    auxv.push_back(id);
+    auxv.push_back(value);
+  }
+  auxv.push_back(AT_NULL);
+  auxv.push_back(0);
+  append_core_note(notes, NT_AUXV, auxv.data(), auxv.size() * sizeof(std::uint64_t));
+
+  Elf64_Ehdr header{};
+  std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_NONE;
+  header.e_type = ET_CORE;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_phoff = sizeof(Elf64_Ehdr);
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_phentsize = sizeof(Elf64_Phdr);
+  header.e_phnum = regions.size() + 1;
+
+  std::vector<Elf64_Phdr> program_headers;
+  auto notes_offset = header.e_phoff + header.e_phnum * sizeof(Elf64_Phdr);
+  program_headers.push_back(Elf64_Phdr{ PT_NOTE, 0, notes_offset, 0, 0, notes.size(), 0, 4 });
+
+  // Segments start page-aligned after the notes so the file can be mmapped segment by segment
+  auto offset = (notes_offset + notes.size() + page_size - 1) & ~(page_size - 1);
+  for (auto& region : regions) {
+    auto size = region.end.addr() - region.start.addr();
+    Elf64_Word flags = (region.readable ? PF_R : 0) | (region.writable ? PF_W : 0) | (region.executable ? PF_X : 0);
+    auto file_size = region.readable ? size : 0;
+    program_headers.push_back(Elf64_Phdr{
+      PT_LOAD, flags, offset, region.start.addr(), 0, file_size, size, page_size
+    });
+    offset += file_size;
+  }
+
+  int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (out < 0) {
+    error::send_errno("Could not open core file");
+  }
+
+  int mem = open(("/proc/" + std::to_string(pid_) + "/mem").c_str(), O_RDONLY | O_CLOEXEC);
+  if (mem < 0) {
+    close(out);
+    error::send_errno("Could not open process memory");
+  }
+
+  try {
+    write_all(out, as_bytes(header), sizeof(header), 0);
+    write_all(out, reinterpret_cast<std::byte*>(program_headers.data()),
+      program_headers.size() * sizeof(Elf64_Phdr), header.e_phoff);
+    write_all(out, notes.data(), notes.size(), notes_offset);
+
+    /*
+      Stream each segment through a large buffer. Runs of non-zero pages are
+      written with a single pwrite; zero and unreadable pages are skipped so
+      they become holes in the sparse output file.
+    */
+    std::vector<std::byte> buffer(chunk_size);
+    for (std::size_t i = 0; i < regions.size(); ++i) {
+      auto& phdr = program_headers[i + 1];
+
+      for (std::uint64_t done = 0; done < phdr.p_filesz; done += chunk_size) {
+        auto amount = std::min<std::uint64_t>(chunk_size, phdr.p_filesz - done);
+        auto address = virt_addr{ phdr.p_vaddr + done };
+
+        auto read = pread(mem, buffer.data(), amount, address.addr());
+        if (read != static_cast<ssize_t>(amount)) {
+          // Part of the chunk is unreadable, so fall back to reading it a page at a time
+          for (std::size_t page = 0; page < amount; page += page_size) {
+            if (pread(mem, buffer.data() + page, page_size, address.addr() + page) != static_cast<ssize_t>(page_size)) {
+              std::fill_n(buffer.data() + page, page_size, std::byte{ 0 });
+            }
+          }
+        }
+
+        for (auto site : breakpoint_sites_.get_in_region(address, address + amount)) {
+          if (!site->is_enabled() or site->is_hardware()) continue;
+          buffer[site->address().addr() - address.addr()] = site->saved_data_;
+        }
+
+        std::size_t run_start = 0;
+        for (std::size_t page = 0; page <= amount; page += page_size) {
+          if (page == amount or is_zero_page(buffer.data() + page, page_size)) {
+            if (page > run_start) {
+              write_all(out, buffer.data() + run_start, page - run_start, phdr.p_offset + done + run_start);
+            }
+            run_start = page + page_size;
+          }
+        }
+      }
+    }
+
+    if (ftruncate(out, offset) < 0) {
+      error::send_errno("Could not size core file");
+    }
+  } catch (...) {
+    close(mem);
+    close(out);
+    throw;
+  }
+
+  close(mem);
+  close(out);
+}
+
+pid_t sdb::process::fork_without_breakpoints() {
+  // Keep int3s out of the child's memory
+  std::vector<breakpoint_site*> to_reenable;
+  breakpoint_sites_.for_each([&](auto& site) {
+    if (site.is_enabled() and !site.is_hardware()) {
+      site.disable();
+      to_reenable.push_back(&site);
+    }
+  });
+
+  pid_t child;
+  try {
+    child = fork_stopped(pid_);
+  } catch (...) {
+    for (auto site : to_reenable) site->enable();
+    throw;
+  }
+
+  for (auto site : to_reenable) site->enable();
+  return child;
+}
+
+int sdb::process::create_checkpoint() {
+  ensure_live();
+
+  // Restarting kills the current inferior, which sdb must not do to a process it only attached to
+  if (!terminate_on_end_) {
+    error::send("Checkpoints are only supported for processes launched by sdb");
+  }
+
+  if (state_ != process_state::stopped) {
+    error::send("Process must be stopped to create a checkpoint");
+  }
+  if (expecting_syscall_exit_) {
+    error::send("Cannot create a checkpoint inside a syscall");
+  }
+
+  // Breakpoints are re-applied when the checkpoint is restarted
+  auto child = fork_without_breakpoints();
+
+  auto id = next_checkpoint_id_++;
+  checkpoints_.push_back({ id, child, get_pc() });
+  return id;
+}
+
+std::int64_t sdb::process::inject_syscall(std::uint64_t number, const std::array<std::uint64_t, 6>& args) {
+  ensure_live();
+
+  if (state_ != process_state::stopped) {
+    error::send("Process must be stopped to inject a syscall");
+  }
+  if (expecting_syscall_exit_) {
+    error::send("Cannot inject a syscall inside a syscall");
+  }
+
+  return run_injected_syscall(pid_, number, args);
+}
+
+std::unique_ptr<sdb::process> sdb::process::clone_stopped() {
+  ensure_live();
+
+  if (state_ != process_state::stopped) {
+    error::send("Process must be stopped to be cloned");
+  }
+  if (expecting_syscall_exit_) {
+    error::send("Cannot clone a process inside a syscall");
+  }
+
+  auto child = fork_without_breakpoints();
+
+  std::unique_ptr<process> proc (new process(child, /*terminate_on_end=*/true, /*attached=*/true));
+  proc->read_all_registers();
+  return proc;
+}
+
+void sdb::process::restart_checkpoint(int id) {
+  ensure_live();
+
+  if (!terminate_on_end_) {
+    error::send("Checkpoints are only supported for processes launched by sdb");
+  }
+
+  auto it = std::find_if(begin(checkpoints_), end(checkpoints_), [=](auto& point) { return point.id == id; });
+  if (it == end(checkpoints_)) {
+    error::send("Invalid checkpoint id");
+  }
+
+  // Fork the checkpoint again so that it stays pristine for future restarts
+  auto fresh = fork_stopped(it->pid);
+
+  if (state_ != process_state::exited and state_ != process_state::terminated) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  }
+
+  pid_ = fresh;
+  state_ = process_state::stopped;
+  is_attached_ = true;
+  expecting_syscall_exit_ = false;
+  replaying_current_syscall_ = false;
+  read_all_registers();
+
+  // Recorded history belongs to the inferior that was just killed
+  if (execution_log_) execution_log_->clear();
+
+  // The new inferior has clean memory and no debug registers set, so re-apply every enabled stoppoint
+  breakpoint_sites_.for_each([](auto& site) {
+    if (!site.is_enabled_) return;
+    site.is_enabled_ = false;
+    site.hardware_register_index_ = -1;
+    site.enable();
+  });
+
+  watchpoints_.for_each([](auto& point) {
+    if (!point.is_enabled_) return;
+    point.is_enabled_ = false;
+    point.hardware_register_index_ = -1;
+    point.enable();
+  });
+}
+
+void sdb::process::delete_checkpoint(int id) {
+  auto it = std::find_if(begin(checkpoints_), end(checkpoints_), [=](auto& point) { return point.id == id; });
+  if (it == end(checkpoints_)) {
+    error::send("Invalid checkpoint id");
+  }
+
+  kill(it->pid, SIGKILL);
+  waitpid(it->pid, nullptr, __WALL);
+  checkpoints_.erase(it);
+}
+
+void sdb::process::start_recording(std::size_t capacity) {
+  ensure_live();
+  // Recording single-steps the inferior, which never produces syscall stops
+  if (syscall_catch_policy_.get_mode() != syscall_catch_policy::mode::none or
+      syscall_log_mode_ != syscall_log_mode::off) {
+    error::send("Can't record execution while syscalls are being caught or logged");
+  }
+  execution_log_ = std::make_unique<execution_log>(capacity);
+}
+
+sdb::stop_reason sdb::process::record_step() {
+  std::vector<execution_log::memory_write> writes;
+  for (auto& range : disassembler(*this).memory_writes()) {
+    try {
+      writes.push_back({ range.address, read_memory_without_traps(range.address, range.size) });
+    } catch (const error&) {
+      // The instruction will fault rather than write to memory that can't be read
+    }
+  }
+
+  auto before = get_registers().data_;
+  auto reason = single_step();
+
+  if (reason.reason == process_state::stopped) {
+    auto& after = get_registers().data_;
+    execution_log_->push(before.regs, before.i387, after.regs, after.i387, writes);
+  }
+
+  return reason;
+}
+
+sdb::stop_reason sdb::process::record_until_stop() {
+  state_ = process_state::stopped;
+
+  while (true) {
+    auto reason = record_step();
+    if (reason.reason != process_state::stopped or reason.info != SIGTRAP or
+        reason.trap_reason != trap_type::single_step) {
+      return reason;
+    }
+
+    // Breakpoints are never executed while stepping, so report them as they're reached
+    if (breakpoint_sites_.enabled_stoppoint_at_address(get_pc())) {
+      reason.trap_reason = trap_type::software_break;
+      return reason;
+    }
+  }
+}
+
+void sdb::process::undo_recorded_step() {
+  auto& data = get_registers().data_;
+  auto writes = execution_log_->pop(data.regs, data.i387);
+
+  for (auto& write : writes) {
+    // Breakpoints enabled in the restored range keep their trap, and now guard the restored byte
+    auto data = write.old_data;
+    auto end = write.address + data.size();
+    for (auto site : breakpoint_sites_.get_in_region(write.address, end)) {
+      if (!site->is_enabled() or site->is_hardware()) continue;
+
+      auto offset = (site->address() - write.address.addr()).addr();
+      site->saved_data_ = data[offset];
+      data[offset] = std::byte{ 0xcc };
+    }
+    write_memory(write.address, { data.data(), data.size() });
+  }
+  write_gprs(data.regs);
+  write_fprs(data.i387);
+}
+
+sdb::stop_reason sdb::process::reverse_step_instruction() {
+  ensure_live();
+
+  if (!execution_log_ or execution_log_->empty()) {
+    error::send("No recorded history to reverse through");
+  }
+
+  undo_recorded_step();
+
+  stop_reason reason(W_STOPCODE(SIGTRAP));
+  reason.trap_reason = trap_type::single_step;
+  return reason;
+}
+
+sdb::stop_reason sdb::process::reverse_continue() {
+  auto reason = reverse_step_instruction();
+
+  while (!breakpoint_sites_.enabled_stoppoint_at_address(get_pc()) and !execution_log_->empty()) {
+    undo_recorded_step();
+  }
+
+  if (breakpoint_sites_.enabled_stoppoint_at_address(get_pc())) {
+    reason.trap_reason = trap_type::software_break;
+  }
+  return reason;
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cxxabi.h>
+#include <cstdio>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <libsdb/bit.hpp>
+#include <libsdb/elf.hpp>
+#include <libsdb/error.hpp>
+#include <libsdb/process.hpp>
+#include <libsdb/profiler.hpp>
+
+namespace {
+  int perf_event_open(perf_event_attr& attr, pid_t pid, int cpu) {
+    return syscall(SYS_perf_event_open, &attr, pid, cpu, /*group_fd=*/-1, PERF_FLAG_FD_CLOEXEC);
+  }
+
+  std::string symbol_name(const sdb::elf& obj, std::uint64_t address, std::optional<const Elf64_Sym*> sym) {
+    if (!sym or sym.value()->st_name == 0) {
+      char buf[19];
+      std::snprintf(buf, sizeof(buf), "%#lx", address);
+      return buf;
+    }
+
+    auto name = obj.get_string(sym.value()->st_name);
+    int demangle_status;
+    auto demangled = abi::__cxa_demangle(name.data(), nullptr, nullptr, &demangle_status);
+    if (demangle_status != 0) return std::string(name);
+
+    std::string ret = demangled;
+    free(demangled);
+    return ret;
+  }
+}
+
+sdb::profiler::profiler(process& proc, std::uint64_t frequency, std::size_t buffer_pages) {
+  // The ring buffer must be a power of two number of pages
+  if (buffer_pages == 0 or (buffer_pages & (buffer_pages - 1)) != 0) {
+    error::send("Profiler buffer size must be a power of two number of pages");
+  }
+
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_CPU_CLOCK;
+  attr.freq = 1;
+  attr.sample_freq = frequency;
+  attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.exclude_callchain_kernel = 1;
+  attr.wakeup_events = 1;
+
+  auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  data_size_ = buffer_pages * page_size;
+  // The first page holds the perf_event_mmap_page control header
+  ring_size_ = data_size_ + page_size;
+
+  // The destructor doesn't run if construction fails, so release what we have so far
+  auto fail = [this](const char* message) {
+    auto saved_errno = errno;
+    for (auto& buffer : rings_) {
+      munmap(buffer.data, ring_size_);
+      close(buffer.fd);
+    }
+    errno = saved_errno;
+    error::send_errno(message);
+  };
+
+  auto n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (long cpu = 0; cpu < n_cpus; ++cpu) {
+    int fd = perf_event_open(attr, proc.pid(), cpu);
+    if (fd < 0) {
+      // Offline CPUs can't be sampled, but they won't run the inferior either
+      if (errno == ENODEV) continue;
+      fail("Could not open perf event");
+    }
+
+    void* data = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      fail("Could not mmap perf ring buffer");
+    }
+
+    rings_.push_back({ fd, data });
+  }
+}
+
+sdb::profiler::~profiler() {
+  for (auto& buffer : rings_) {
+    munmap(buffer.data, ring_size_);
+    close(buffer.fd);
+  }
+}
+
+void sdb::profiler::enable() {
+  for (auto& buffer : rings_) {
+    if (ioctl(buffer.fd, PERF_EVENT_IOC_ENABLE, 0) < 0) {
+      error::send_errno("Could not enable perf event");
+    }
+  }
+}
+
+void sdb::profiler::disable() {
+  for (auto& buffer : rings_) {
+    if (ioctl(buffer.fd, PERF_EVENT_IOC_DISABLE, 0) < 0) {
+      error::send_errno("Could not disable perf event");
+    }
+  }
+}
+
+bool sdb::profiler::poll(int timeout_ms) {
+  std::vector<pollfd> fds;
+  for (auto& buffer : rings_) {
+    fds.push_back({ buffer.fd, POLLIN, 0 });
+  }
+
+  if (::poll(fds.data(), fds.size(), timeout_ms) < 0 and errno != EINTR) {
+    error::send_errno("Could not poll perf events");
+  }
+
+  drain();
+
+  // The kernel signals POLLHUP once the profiled task has exited
+  return std::none_of(begin(fds), end(fds), [](auto& pfd) { return pfd.revents & POLLHUP; });
+}
+
+void sdb::profiler::drain() {
+  for (auto& buffer : rings_) {
+    drain(buffer);
+  }
+}
+
+void sdb::profiler::drain(ring& buffer) {
+  auto header = static_cast<perf_event_mmap_page*>(buffer.data);
+  auto data = static_cast<std::byte*>(buffer.data) + (ring_size_ - data_size_);
+
+  auto head = __atomic_load_n(&header->data_head, __ATOMIC_ACQUIRE);
+  auto tail = header->data_tail;
+
+  std::vector<std::byte> wrapped;
+  while (tail < head) {
+    auto offset = tail % data_size_;
+    auto record_header = from_bytes<perf_event_header>(data + offset);
+    auto record = data + offset;
+
+    // Records that straddle the end of the ring are copied out so they can be parsed contiguously
+    if (offset + record_header.size > data_size_) {
+      wrapped.resize(record_header.size);
+      auto first = data_size_ - offset;
+      std::copy(data + offset, data + data_size_, wrapped.data());
+      std::copy(data, data + (record_header.size - first), wrapped.data() + first);
+      record = wrapped.data();
+    }
+
+    handle_record(record);
+    tail += record_header.size;
+  }
+
+  __atomic_store_n(&header->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void sdb::profiler::handle_record(const std::byte* record) {
+  auto header = from_bytes<perf_event_header>(record);
+  auto pos = record + sizeof(header);
+
+  if (header.type == PERF_RECORD_LOST) {
+    lost_count_ += from_bytes<std::uint64_t>(pos + sizeof(std::uint64_t));
+    return;
+  }
+
+  if (header.type != PERF_RECORD_SAMPLE) return;
+
+  // Layout follows sample_type: ip, pid/tid, then the callchain
+  auto ip = from_bytes<std::uint64_t>(pos);
+  pos += sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+  auto n_frames = from_bytes<std::uint64_t>(pos);
+  pos += sizeof(std::uint64_t);
+
+  std::vector<std::uint64_t> chain;
+  chain.reserve(n_frames);
+  for (std::uint64_t i = 0; i < n_frames; ++i) {
+    auto frame = from_bytes<std::uint64_t>(pos + i * sizeof(std::uint64_t));
+    // Skip PERF_CONTEXT_USER and friends, which mark context switches in the chain
+    if (frame >= static_cast<std::uint64_t>(PERF_CONTEXT_MAX)) continue;
+    chain.push_back(frame);
+  }
+
+  if (chain.empty()) chain.push_back(ip);
+
+  ++stacks_[std::move(chain)];
+  ++sample_count_;
+}
+
+void sdb::profiler::write_folded_stacks(std::ostream& out, const elf& obj) const {
+  /*
+    Symbolize each unique address once rather than once per sample, in address
+    order so the whole batch is resolved in one pass over the symbol table.
+    Return addresses point at the instruction after the call, which may be
+    past the end of the calling function, so callers are looked up at address - 1.
+  */
+  std::vector<virt_addr> addresses;
+  for (auto& [chain, count] : stacks_) {
+    for (std::size_t i = 0; i < chain.size(); ++i) {
+      addresses.push_back(virt_addr{ i == 0 ? chain[i] : chain[i] - 1 });
+    }
+  }
+  std::sort(begin(addresses), end(addresses));
+  addresses.erase(std::unique(begin(addresses), end(addresses)), end(addresses));
+
+  auto symbols = obj.symbolize(addresses);
+  std::unordered_map<std::uint64_t, std::string> names;
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    names.emplace(addresses[i].addr(), symbol_name(obj, addresses[i].addr(), symbols[i]));
+  }
+
+  std::map<std::string, std::uint64_t> folded;
+  for (auto& [chain, count] : stacks_) {
+    std::string line;
+    for (auto i = chain.size(); i-- > 0;) {
+      line += names.at(i == 0 ? chain[i] : chain[i] - 1);
+      if (i != 0) line += ';';
+    }
+    folded[line] += count;
+  }
+
+  for (auto& [line, count] : folded) {
+    out << line << ' ' << count << '\n';
+  }
+}
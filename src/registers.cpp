@@ -57,6 +57,10 @@ sdb::registers::value sdb::registers::read(const register_info& info) const {
 }
 
 void sdb::registers::write(const register_info& info, value val) {
+  if (proc_->is_core()) {
+    error::send("Cannot write registers of a core file");
+  }
+
   auto bytes = as_bytes(data_);
 
   std::visit([&](auto& v) {
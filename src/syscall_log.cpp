@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <fstream>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <libsdb/error.hpp>
+#include <libsdb/process.hpp>
+#include <libsdb/syscall_log.hpp>
+
+namespace {
+  constexpr char log_magic[8] = { 'S', 'D', 'B', 'S', 'Y', 'S', 'L', 'G' };
+  constexpr std::uint32_t log_version = 1;
+
+  template <class T>
+  void write_value(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <class T>
+  T read_value(std::istream& in) {
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+      sdb::error::send("Syscall log is truncated");
+    }
+    return value;
+  }
+}
+
+sdb::syscall_log sdb::syscall_log::load(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error::send("Could not open syscall log " + path.string());
+  }
+
+  char magic[sizeof(log_magic)];
+  if (!in.read(magic, sizeof(magic)) or !std::equal(magic, magic + sizeof(magic), log_magic)) {
+    error::send("Not a syscall log");
+  }
+  if (read_value<std::uint32_t>(in) != log_version) {
+    error::send("Unsupported syscall log version");
+  }
+
+  syscall_log log;
+  auto n_entries = read_value<std::uint64_t>(in);
+  for (std::uint64_t i = 0; i < n_entries; ++i) {
+    entry e;
+    e.id = read_value<std::uint16_t>(in);
+    e.ret = read_value<std::int64_t>(in);
+
+    auto n_outputs = read_value<std::uint32_t>(in);
+    for (std::uint32_t j = 0; j < n_outputs; ++j) {
+      auto& output = e.outputs.emplace_back(read_value<std::uint64_t>(in));
+      if (!in.read(reinterpret_cast<char*>(output.data()), output.size())) {
+        error::send("Syscall log is truncated");
+      }
+    }
+
+    log.push(std::move(e));
+  }
+
+  return log;
+}
+
+void sdb::syscall_log::save(const std::filesystem::path& path) const {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    error::send("Could not create syscall log " + path.string());
+  }
+
+  out.write(log_magic, sizeof(log_magic));
+  write_value(out, log_version);
+  write_value(out, static_cast<std::uint64_t>(entries_.size()));
+
+  for (auto& e : entries_) {
+    write_value(out, e.id);
+    write_value(out, e.ret);
+    write_value(out, static_cast<std::uint32_t>(e.outputs.size()));
+    for (auto& output : e.outputs) {
+      write_value(out, static_cast<std::uint64_t>(output.size()));
+      out.write(reinterpret_cast<const char*>(output.data()), output.size());
+    }
+  }
+
+  if (!out) {
+    error::send("Could not write syscall log " + path.string());
+  }
+}
+
+bool sdb::syscall_log::is_logged(std::uint16_t id) {
+  switch (id) {
+    case SYS_read:
+    case SYS_pread64:
+    case SYS_recvfrom:
+    case SYS_getrandom:
+    case SYS_clock_gettime:
+    case SYS_gettimeofday:
+    case SYS_time:
+    case SYS_epoll_wait:
+    case SYS_epoll_pwait:
+    case SYS_poll:
+    case SYS_ppoll:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::uint64_t sdb::syscall_log::entry_bound(
+  const process& proc, std::uint16_t id, const std::array<std::uint64_t, 6>& args) {
+  if (id != SYS_recvfrom or args[4] == 0 or args[5] == 0) return 0;
+
+  // A bad pointer makes the syscall fail with EFAULT, so there is nothing to bound
+  try {
+    return proc.read_memory_as<socklen_t>(virt_addr{ args[5] });
+  } catch (const error&) {
+    return 0;
+  }
+}
+
+std::vector<sdb::syscall_log::output_range> sdb::syscall_log::output_ranges(
+  const process& proc, std::uint16_t id,
+  const std::array<std::uint64_t, 6>& args, std::uint64_t entry_bound, std::int64_t ret) {
+  std::vector<output_range> ranges;
+  if (ret < 0) return ranges;
+
+  auto add = [&](std::uint64_t address, std::size_t size) {
+    if (address != 0 and size != 0) ranges.push_back({ virt_addr{ address }, size });
+  };
+
+  switch (id) {
+    case SYS_read:
+    case SYS_pread64:
+      add(args[1], ret);
+      break;
+    case SYS_recvfrom:
+      add(args[1], ret);
+      // The kernel sets *addrlen to the address's full length, which may be more than
+      // the caller's buffer held, so only what fitted in the buffer was written
+      if (args[4] != 0 and args[5] != 0) {
+        auto length = proc.read_memory_as<socklen_t>(virt_addr{ args[5] });
+        add(args[4], std::min<std::uint64_t>(entry_bound, length));
+        add(args[5], sizeof(socklen_t));
+      }
+      break;
+    case SYS_getrandom:
+      add(args[0], ret);
+      break;
+    case SYS_clock_gettime:
+      add(args[1], sizeof(timespec));
+      break;
+    case SYS_gettimeofday:
+      add(args[0], sizeof(timeval));
+      add(args[1], sizeof(struct timezone));
+      break;
+    case SYS_time:
+      add(args[0], sizeof(time_t));
+      break;
+    case SYS_epoll_wait:
+    case SYS_epoll_pwait:
+      add(args[1], ret * sizeof(epoll_event));
+      break;
+    case SYS_poll:
+    case SYS_ppoll:
+      add(args[0], args[1] * sizeof(pollfd));
+      break;
+  }
+
+  return ranges;
+}
+
+std::vector<sdb::syscall_log::output_range> sdb::syscall_log::max_output_ranges(
+  const process& proc, std::uint16_t id, const std::array<std::uint64_t, 6>& args) {
+  std::int64_t max_ret = 0;
+  switch (id) {
+    case SYS_read:
+    case SYS_pread64:
+    case SYS_recvfrom:
+    case SYS_epoll_wait:
+    case SYS_epoll_pwait:
+      max_ret = args[2];
+      break;
+    case SYS_getrandom:
+      max_ret = args[1];
+      break;
+  }
+  return output_ranges(proc, id, args, entry_bound(proc, id, args), max_ret);
+}
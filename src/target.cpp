@@ -1,7 +1,49 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <link.h>
+#include <sys/stat.h>
+#include <libsdb/error.hpp>
 #include <libsdb/target.hpp>
 #include <libsdb/types.hpp>
 
 namespace {
+  std::string read_string(const sdb::process& proc, sdb::virt_addr address) {
+    std::string ret;
+    while (true) {
+      // Read at most up to the end of the page so we can't run into an unmapped one
+      auto amount = 0x1000 - (address.addr() & 0xfff);
+      for (auto c : proc.read_memory(address, amount)) {
+        if (c == std::byte{ 0 }) return ret;
+        ret += static_cast<char>(c);
+      }
+      address += amount;
+    }
+  }
+
+  // Shared libraries have their ELF header mapped at their load bias,
+  // so their extent can be found without opening the file
+  std::pair<sdb::virt_addr, sdb::virt_addr> read_module_extent(const sdb::process& proc, sdb::virt_addr load_bias) {
+    try {
+      auto header = proc.read_memory_as<Elf64_Ehdr>(load_bias);
+      if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) return {};
+
+      auto phdrs = proc.read_memory(load_bias + header.e_phoff, header.e_phnum * sizeof(Elf64_Phdr));
+      std::uint64_t low = UINT64_MAX, high = 0;
+      for (std::size_t i = 0; i < header.e_phnum; ++i) {
+        auto phdr = sdb::from_bytes<Elf64_Phdr>(phdrs.data() + i * sizeof(Elf64_Phdr));
+        if (phdr.p_type != PT_LOAD) continue;
+        low = std::min(low, phdr.p_vaddr);
+        high = std::max(high, phdr.p_vaddr + phdr.p_memsz);
+      }
+      if (low >= high) return {};
+      return { load_bias + low, load_bias + high };
+    } catch (const sdb::error&) {
+      return {};
+    }
+  }
+
   std::unique_ptr<sdb::elf> create_loaded_elf(
     const sdb::process& proc,
     const std::filesystem::path& path
@@ -14,12 +56,24 @@ namespace {
   }
 }
 
+sdb::target::target(std::unique_ptr<process> proc, std::unique_ptr<elf> obj)
+  : process_(std::move(proc)), elf_(std::move(obj)) {
+  process_->set_stop_handler([this](auto& reason) { return notify_stop(reason); });
+  resolve_dynamic_linker();
+}
+
 std::unique_ptr<sdb::target> sdb::target::launch(std::filesystem::path path, std::optional<int> stdout_replacement) {
   auto proc = process::launch(path, true, stdout_replacement);
   auto obj = create_loaded_elf(*proc, path);
   return std::unique_ptr<target>(new target(std::move(proc), std::move(obj)));
 }
 
+std::unique_ptr<sdb::target> sdb::target::launch(std::filesystem::path path, const launch_options& options) {
+  auto proc = process::launch(path, options);
+  auto obj = create_loaded_elf(*proc, path);
+  return std::unique_ptr<target>(new target(std::move(proc), std::move(obj)));
+}
+
 std::unique_ptr<sdb::target> sdb::target::attach(pid_t pid) {
   auto elf_path = std::filesystem::path("/proc") / std::to_string(pid) / "exe";
   auto proc = process::attach(pid);
@@ -27,3 +81,199 @@ std::unique_ptr<sdb::target> sdb::target::attach(pid_t pid) {
   return std::unique_ptr<target>(new target(std::move(proc), std::move(obj)));
 }
 
+
+std::unique_ptr<sdb::target> sdb::target::load_core(const std::filesystem::path& core, const std::filesystem::path& exe) {
+  auto proc = process::load_core(core);
+  auto obj = create_loaded_elf(*proc, exe);
+  return std::unique_ptr<target>(new target(std::move(proc), std::move(obj)));
+}
+
+std::unique_ptr<sdb::target> sdb::target::clone_stopped() {
+  auto proc = process_->clone_stopped();
+  // A fork runs the same file at the same addresses, so share the elf rather than reopening its path
+  auto obj = std::make_unique<elf>(*elf_);
+  return std::unique_ptr<target>(new target(std::move(proc), std::move(obj)));
+}
+
+const sdb::elf* sdb::target::get_elf_containing_address(virt_addr address) const {
+  if (elf_->get_section_containing_address(address)) return elf_.get();
+
+  auto it = std::upper_bound(begin(modules_), end(modules_), address, [](auto addr, auto& module) {
+    return addr < module.start;
+  });
+  if (it != begin(modules_) and address < std::prev(it)->end) {
+    --it;
+    if (!it->obj) {
+      try {
+        it->obj = std::make_unique<elf>(module_file(*it));
+      } catch (const error&) {
+        return nullptr;
+      }
+      it->obj->notify_loaded(it->load_bias);
+    }
+    return it->obj.get();
+  }
+
+  auto vdso = get_vdso();
+  if (vdso and vdso->get_section_containing_address(address)) return vdso;
+  return nullptr;
+}
+
+const sdb::elf* sdb::target::get_vdso() const {
+  if (vdso_loaded_) return vdso_.get();
+  vdso_loaded_ = true;
+
+  auto base = process_->get_auxv()[AT_SYSINFO_EHDR];
+  if (base == 0) return nullptr;
+
+  try {
+    // The section headers come last in the vDSO and are mapped along with the rest,
+    // so the header says how much to read and the image is copied in one go
+    auto header = process_->read_memory_as<Elf64_Ehdr>(virt_addr{ base });
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) return nullptr;
+
+    auto size = std::max(
+      header.e_shoff + std::uint64_t(header.e_shnum) * sizeof(Elf64_Shdr),
+      header.e_phoff + std::uint64_t(header.e_phnum) * sizeof(Elf64_Phdr));
+    // Far larger than any real vDSO, so a corrupt header can't make us read the whole address space
+    constexpr std::uint64_t max_vdso_size = 0x100000;
+    if (size > max_vdso_size) return nullptr;
+
+    auto image = elf_image::from_memory("[vdso]", process_->read_memory(virt_addr{ base }, size));
+
+    // The image starts at the segment that maps file offset zero
+    auto bias = base;
+    for (auto& segment : image->program_headers()) {
+      if (segment.p_type == PT_LOAD and segment.p_offset == 0) {
+        bias = base - segment.p_vaddr;
+        break;
+      }
+    }
+
+    vdso_ = std::make_unique<elf>(std::move(image));
+    vdso_->notify_loaded(virt_addr{ bias });
+  } catch (const error&) {
+    vdso_.reset();
+  }
+
+  return vdso_.get();
+}
+
+std::filesystem::path sdb::target::module_file(const loaded_module& module) const {
+  if (process_->is_core()) return module.path;
+
+  // The library's first mapping starts at its lowest loadable segment
+  auto regions = process_->get_memory_regions();
+  auto region = std::find_if(begin(regions), end(regions), [&](auto& region) {
+    return region.start == module.start;
+  });
+  if (region == end(regions)) return module.path;
+
+  struct stat stats;
+  bool replaced = region->path.size() >= 10 and region->path.substr(region->path.size() - 10) == " (deleted)";
+  replaced = replaced or stat(module.path.c_str(), &stats) < 0 or stats.st_ino != region->inode;
+  if (!replaced) return module.path;
+
+  // map_files links to the file that is actually mapped, even once it is gone from the file system
+  char range[40];
+  std::snprintf(range, sizeof(range), "%lx-%lx", region->start.addr(), region->end.addr());
+  return std::filesystem::path("/proc") / std::to_string(process_->pid()) / "map_files" / range;
+}
+
+bool sdb::target::notify_stop(const stop_reason& reason) {
+  if (!rendezvous_breakpoint_ or reason.info != SIGTRAP or
+      reason.trap_reason != trap_type::software_break or
+      process_->get_pc() != *rendezvous_breakpoint_) {
+    return false;
+  }
+
+  // The hook is called once before the link map changes and once after; only the latter is consistent
+  auto debug = process_->read_memory_as<r_debug>(*rendezvous_address_);
+  if (debug.r_state == r_debug::RT_CONSISTENT) {
+    reload_modules();
+  }
+  return true;
+}
+
+std::optional<sdb::virt_addr> sdb::target::read_rendezvous_address() const {
+  auto dynamic = elf_->get_section(".dynamic");
+  if (!dynamic) return std::nullopt;
+
+  auto address = virt_addr{ dynamic.value()->sh_addr } + elf_->load_bias().addr();
+  auto data = process_->read_memory(address, dynamic.value()->sh_size);
+  for (std::size_t pos = 0; pos + sizeof(Elf64_Dyn) <= data.size(); pos += sizeof(Elf64_Dyn)) {
+    auto entry = from_bytes<Elf64_Dyn>(data.data() + pos);
+    if (entry.d_tag == DT_NULL) break;
+    if (entry.d_tag == DT_DEBUG and entry.d_un.d_ptr != 0) return virt_addr{ entry.d_un.d_ptr };
+  }
+
+  return std::nullopt;
+}
+
+void sdb::target::resolve_dynamic_linker() {
+  // Once the dynamic linker has run, it publishes r_debug through DT_DEBUG
+  if (auto address = read_rendezvous_address()) {
+    rendezvous_address_ = address;
+    reload_modules();
+    return;
+  }
+
+  // Before that, which is the case right after exec, the linker's own symbols are needed.
+  // Statically linked programs have no interpreter and so no libraries to track.
+  auto interp = elf_->get_section_contents(".interp");
+  auto base = process_->get_auxv()[AT_BASE];
+  if (process_->is_core() or interp.size() == 0 or base == 0) return;
+
+  try {
+    elf linker(std::string(reinterpret_cast<const char*>(interp.begin())));
+    auto debug = linker.get_symbols_by_name("_r_debug");
+    auto hook = linker.get_symbols_by_name("_dl_debug_state");
+    if (debug.empty() or hook.empty()) return;
+
+    rendezvous_address_ = virt_addr{ base + debug[0]->st_value };
+    rendezvous_breakpoint_ = virt_addr{ base + hook[0]->st_value };
+    process_->create_breakpoint_site(*rendezvous_breakpoint_, false, true).enable();
+  } catch (const error&) {
+    rendezvous_address_.reset();
+    rendezvous_breakpoint_.reset();
+  }
+}
+
+void sdb::target::reload_modules() {
+  auto debug = process_->read_memory_as<r_debug>(*rendezvous_address_);
+
+  if (!rendezvous_breakpoint_ and debug.r_brk != 0 and !process_->is_core()) {
+    rendezvous_breakpoint_ = virt_addr{ debug.r_brk };
+    if (!process_->breakpoint_sites().contains_address(*rendezvous_breakpoint_)) {
+      process_->create_breakpoint_site(*rendezvous_breakpoint_, false, true).enable();
+    }
+  }
+
+  std::vector<loaded_module> modules;
+  // Bounded so that a corrupted list can't loop forever
+  constexpr std::size_t max_modules = 65536;
+  auto map_address = reinterpret_cast<std::uint64_t>(debug.r_map);
+  for (std::size_t i = 0; map_address != 0 and i < max_modules; ++i) {
+    auto entry = process_->read_memory_as<link_map>(virt_addr{ map_address });
+    map_address = reinterpret_cast<std::uint64_t>(entry.l_next);
+
+    if (!entry.l_name) continue;
+    auto name = read_string(*process_, virt_addr{ reinterpret_cast<std::uint64_t>(entry.l_name) });
+    // The main program has an empty name and the vDSO's name is not a path
+    if (name.find('/') == std::string::npos) continue;
+
+    auto& module = modules.emplace_back();
+    module.path = name;
+    module.load_bias = virt_addr{ entry.l_addr };
+    std::tie(module.start, module.end) = read_module_extent(*process_, module.load_bias);
+
+    // Libraries that are still loaded keep the elf they already opened
+    auto old = std::find_if(begin(modules_), end(modules_), [&](auto& m) {
+      return m.path == module.path and m.load_bias == module.load_bias;
+    });
+    if (old != end(modules_)) module.obj = std::move(old->obj);
+  }
+
+  std::sort(begin(modules), end(modules), [](auto& lhs, auto& rhs) { return lhs.start < rhs.start; });
+  modules_ = std::move(modules);
+}
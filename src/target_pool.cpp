@@ -0,0 +1,55 @@
+#include <csignal>
+#include <elf.h>
+#include <sys/syscall.h>
+#include <libsdb/error.hpp>
+#include <libsdb/target_pool.hpp>
+
+namespace {
+  void set_sigchld_handler(sdb::process& proc, void (*handler)(int)) {
+    struct {
+      std::uint64_t handler;
+      std::uint64_t flags;
+      std::uint64_t restorer;
+      std::uint64_t mask;
+    } action{ reinterpret_cast<std::uint64_t>(handler), 0, 0, 0 };
+
+    // Below the red zone, which is free scratch space at the entry point
+    auto rsp = proc.get_registers().read_by_id_as<std::uint64_t>(sdb::register_id::rsp);
+    auto scratch = sdb::virt_addr{ (rsp - 128 - sizeof(action)) & ~std::uint64_t(0xf) };
+    proc.write_memory(scratch, { sdb::as_bytes(action), sizeof(action) });
+
+    auto ret = proc.inject_syscall(SYS_rt_sigaction, { SIGCHLD, scratch.addr(), 0, sizeof(action.mask) });
+    if (ret < 0) {
+      sdb::error::send("Could not configure pooled process");
+    }
+  }
+}
+
+sdb::target_pool::target_pool(std::filesystem::path path, const launch_options& options)
+  : template_(target::launch(std::move(path), options)) {
+  auto& proc = template_->get_process();
+  auto entry = virt_addr{ proc.get_auxv()[AT_ENTRY] };
+
+  auto& site = proc.create_breakpoint_site(entry, /*hardware=*/false, /*internal=*/true);
+  site.enable();
+  proc.resume();
+  auto reason = proc.wait_on_signal();
+
+  if (reason.reason != process_state::stopped or proc.get_pc() != entry) {
+    error::send("Template process did not reach its entry point");
+  }
+
+  proc.breakpoint_sites().remove_by_id(site.id());
+
+  // Clones are the template's children. With SIGCHLD ignored the kernel reaps them
+  // once sdb has waited on them, rather than leaving zombies behind in the template.
+  set_sigchld_handler(proc, SIG_IGN);
+}
+
+std::unique_ptr<sdb::target> sdb::target_pool::acquire() {
+  auto clone = template_->clone_stopped();
+  // The ignored disposition would otherwise be inherited, and survive exec, leaving the
+  // clone unable to wait for children of its own
+  set_sigchld_handler(clone->get_process(), SIG_DFL);
+  return clone;
+}
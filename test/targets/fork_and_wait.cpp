@@ -0,0 +1,11 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main() {
+  auto pid = fork();
+  if (pid == 0) _exit(42);
+
+  int status;
+  if (waitpid(pid, &status, 0) != pid) return 1;
+  return WIFEXITED(status) and WEXITSTATUS(status) == 42 ? 0 : 2;
+}
@@ -0,0 +1,11 @@
+#include <signal.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+int main() {
+  raise(SIGTRAP);
+
+  unsigned long long value;
+  while (getrandom(&value, sizeof(value), 0) != sizeof(value));
+  write(STDOUT_FILENO, &value, sizeof(value));
+}
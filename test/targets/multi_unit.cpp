@@ -0,0 +1,10 @@
+// Split over several compile units so that DWARF indexing has more than one to share out
+int square(int value);
+int cube(int value);
+
+int counter = 0;
+
+int main() {
+  counter = square(2) + cube(3);
+  return counter == 0;
+}
@@ -0,0 +1,8 @@
+namespace shapes {
+  int cube_calls = 0;
+}
+
+int cube(int value) {
+  ++shapes::cube_calls;
+  return value * value * value;
+}
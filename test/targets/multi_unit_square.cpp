@@ -0,0 +1,6 @@
+int square_calls = 0;
+
+int square(int value) {
+  ++square_calls;
+  return value * value;
+}
@@ -0,0 +1,47 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+  // Abstract socket names, so that nothing is left in the filesystem
+  sockaddr_un bound_socket(int fd, const char* role, socklen_t& length) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    auto name_length = std::snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "sdb_recvfrom_%s_%d", role, getpid());
+    length = offsetof(sockaddr_un, sun_path) + 1 + name_length;
+    bind(fd, reinterpret_cast<sockaddr*>(&addr), length);
+    return addr;
+  }
+}
+
+int main() {
+  int receiver = socket(AF_UNIX, SOCK_DGRAM, 0);
+  int sender = socket(AF_UNIX, SOCK_DGRAM, 0);
+  socklen_t receiver_length, sender_length;
+  auto receiver_addr = bound_socket(receiver, "receiver", receiver_length);
+  bound_socket(sender, "sender", sender_length);
+
+  raise(SIGTRAP);
+
+  sendto(sender, "x", 1, 0, reinterpret_cast<sockaddr*>(&receiver_addr), receiver_length);
+
+  // The sender's address is longer than the buffer, so the kernel truncates it
+  // but still reports its full length
+  struct {
+    char address[4];
+    char canary[60];
+  } source;
+  std::memset(source.canary, 0x5a, sizeof(source.canary));
+  socklen_t source_length = sizeof(source.address);
+  char byte;
+  recvfrom(receiver, &byte, 1, 0, reinterpret_cast<sockaddr*>(source.address), &source_length);
+
+  bool canary_intact = true;
+  for (auto c : source.canary) canary_intact = canary_intact and c == 0x5a;
+  unsigned char result[2] = { static_cast<unsigned char>(canary_intact), static_cast<unsigned char>(source_length) };
+  write(STDOUT_FILENO, result, sizeof(result));
+}
@@ -0,0 +1,35 @@
+.global main
+
+.section .data
+        value: .quad 0x1111
+
+.section .text
+.macro trap
+        movq $62, %rax # kill
+        movq %r12, %rdi
+        movq $5, %rsi # SIGTRAP
+        syscall
+.endm
+
+main:
+        push %rbp
+        movq %rsp, %rbp
+
+        movq $39, %rax # getpid
+        syscall
+        movq %rax, %r12
+
+        leaq value(%rip), %r13 # let the debugger find value through r13
+        trap
+
+        # Each of these writes memory in a different way
+        movq $0x2222, %rax
+        movq %rax, value(%rip)
+        push %rax
+        movq $0x3333, (%r13)
+        pop %rax
+        trap
+
+        popq %rbp
+        movq $0, %rax
+        ret
@@ -4,14 +4,23 @@
 #include <fstream>
 #include <memory>
 #include <regex>
+#include <sstream>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <signal.h>
 #include <libsdb/bit.hpp>
+#include <libsdb/core_file.hpp>
 #include <libsdb/pipe.hpp>
 #include <libsdb/process.hpp>
+#include <libsdb/profiler.hpp>
+#include <libsdb/disassembler.hpp>
+#include <libsdb/dwarf.hpp>
 #include <libsdb/error.hpp>
+#include <libsdb/index_cache.hpp>
+#include <libsdb/memory_snapshot.hpp>
 #include <libsdb/syscalls.hpp>
 #include <libsdb/target.hpp>
+#include <libsdb/target_pool.hpp>
 
 using namespace sdb;
 
@@ -85,6 +94,17 @@ namespace {
     auto index_of_status_indicator = index_of_last_parenthesis + 2;
     return data[index_of_status_indicator];
   }
+
+  std::filesystem::path get_libc_path() {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+      if (auto pos = line.find('/'); pos != std::string::npos and line.find("/libc.so") != std::string::npos) {
+        return line.substr(pos);
+      }
+    }
+    return {};
+  }
 }
 
 TEST_CASE("ELF parser works", "[elf]") {
@@ -105,6 +125,457 @@ TEST_CASE("ELF parser works", "[elf]") {
   REQUIRE(name == "_start");
 }
 
+TEST_CASE("ELF section headers and symbols are viewed in place", "[elf]") {
+  sdb::elf elf("targets/multi_unit");
+  REQUIRE(elf.section_headers().size() == elf.get_header().e_shnum);
+  REQUIRE(elf.symbols().size() > 0);
+  REQUIRE(elf.get_section(".symtab"));
+}
+
+TEST_CASE("ELF symbols can be found by demangled name", "[elf]") {
+  sdb::elf elf("targets/multi_unit");
+
+  auto by_mangled = elf.get_symbols_by_name("_Z6squarei");
+  REQUIRE(by_mangled.size() == 1);
+  REQUIRE(elf.get_symbols_by_name("square(int)") == by_mangled);
+
+  auto in_namespace = elf.get_symbols_by_name("shapes::cube_calls");
+  REQUIRE(in_namespace.size() == 1);
+  REQUIRE(elf.get_string(in_namespace[0]->st_name) == std::string_view("_ZN6shapes10cube_callsE"));
+}
+
+TEST_CASE("Batch symbolization agrees with single lookups", "[elf]") {
+  sdb::elf elf("targets/multi_unit");
+  elf.notify_loaded(virt_addr{ 0xcafecafe });
+
+  // In or out of order, inside, at the edges of and between functions
+  auto square = elf.get_symbols_by_name("square(int)").at(0);
+  auto cube = elf.get_symbols_by_name("cube(int)").at(0);
+  std::vector<virt_addr> addresses;
+  for (auto offset : { 0, 1, 4, 2, -1 }) {
+    addresses.push_back(virt_addr{ 0xcafecafe + square->st_value + offset });
+  }
+  addresses.push_back(virt_addr{ 0xcafecafe + cube->st_value + cube->st_size });
+  addresses.push_back(virt_addr{ 0xcafecafe + cube->st_value });
+
+  auto symbols = elf.symbolize(addresses);
+  REQUIRE(symbols.size() == addresses.size());
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    REQUIRE(symbols[i] == elf.get_symbol_containing_address(addresses[i]));
+  }
+  REQUIRE(symbols[0] == square);
+  REQUIRE(symbols.back() == cube);
+}
+
+
+TEST_CASE("ELF images are shared between elfs for the same file", "[elf]") {
+  sdb::elf first("targets/hello_sdb");
+  sdb::elf second(std::filesystem::absolute("targets/hello_sdb"));
+  REQUIRE(&first.image() == &second.image());
+  REQUIRE(&sdb::elf("targets/memory").image() != &first.image());
+
+  // Each elf has its own load bias, and file addresses belong to the elf that made them
+  first.notify_loaded(virt_addr{ 0x10000 });
+  second.notify_loaded(virt_addr{ 0x20000 });
+  auto main_sym = first.get_symbols_by_name("main").at(0);
+  REQUIRE(first.get_symbol_containing_address(virt_addr{ 0x10000 + main_sym->st_value }) == main_sym);
+  REQUIRE(second.get_symbol_containing_address(virt_addr{ 0x20000 + main_sym->st_value }) == main_sym);
+  REQUIRE(!second.get_symbol_containing_address(file_addr{ first, main_sym->st_value }));
+
+  // Targets attached to several copies of one program share a single image
+  auto a = target::launch("targets/run_endlessly");
+  auto b = target::launch("targets/run_endlessly");
+  REQUIRE(&a->get_elf().image() == &b->get_elf().image());
+}
+
+TEST_CASE("ELF indexes are cached by build ID", "[elf]") {
+  auto cache_home = std::filesystem::temp_directory_path() / "sdb_test_cache";
+  std::filesystem::remove_all(cache_home);
+  setenv("XDG_CACHE_HOME", cache_home.c_str(), true);
+
+  {
+    sdb::elf elf("targets/hello_sdb");
+    REQUIRE(elf.build_id());
+    REQUIRE(!elf.address_index_from_cache());
+    REQUIRE(!elf.name_index_from_cache());
+    // The cache is written as each index is built
+    auto entry = elf.get_header().e_entry;
+    REQUIRE(elf.get_symbol_at_address(file_addr{ elf, entry }));
+  }
+
+  {
+    sdb::elf elf("targets/hello_sdb");
+    REQUIRE(elf.address_index_from_cache());
+    REQUIRE(!elf.name_index_from_cache());
+    REQUIRE(elf.get_symbols_by_name("main").size() == 1);
+  }
+
+  {
+    sdb::elf elf("targets/hello_sdb");
+    REQUIRE(elf.address_index_from_cache());
+    REQUIRE(elf.name_index_from_cache());
+    auto main_sym = elf.get_symbols_by_name("main");
+    REQUIRE(main_sym.size() == 1);
+    REQUIRE(elf.get_string(main_sym[0]->st_name) == "main");
+    auto entry = elf.get_header().e_entry;
+    auto sym = elf.get_symbol_at_address(file_addr{ elf, entry });
+    REQUIRE(elf.get_string(sym.value()->st_name) == "_start");
+  }
+
+  // Point a name that lives in .strtab past the end of it
+  auto key = std::filesystem::directory_iterator(index_cache::directory())->path().stem().string();
+  {
+    auto cache = index_cache::load(key);
+    REQUIRE(cache);
+    index_cache::writer writer;
+    for (auto id = index_cache::tag::symbol_starts; id <= index_cache::tag::name_buckets;
+         id = index_cache::tag(static_cast<std::uint32_t>(id) + 1)) {
+      auto blob = cache->get(id).value();
+      std::vector<std::byte> data(blob.begin(), blob.end());
+      if (id == index_cache::tag::name_entries) {
+        // Entries are { symbol, in_arena, offset, size }
+        auto entries = reinterpret_cast<std::uint32_t*>(data.data());
+        for (std::size_t i = 0; i < data.size() / 16; ++i) {
+          if (entries[i * 4 + 1] == 0) {
+            entries[i * 4 + 2] = 0xfffff000;
+            break;
+          }
+        }
+      }
+      writer.add(id, { data.data(), data.size() });
+    }
+    REQUIRE(writer.commit(key));
+  }
+
+  sdb::elf elf("targets/hello_sdb");
+  unsetenv("XDG_CACHE_HOME");
+  std::filesystem::remove_all(cache_home);
+
+  REQUIRE(elf.address_index_from_cache());
+  REQUIRE(!elf.name_index_from_cache());
+  REQUIRE(elf.get_symbols_by_name("main").size() == 1);
+}
+
+TEST_CASE("Stripped ELF names are looked up through .gnu.hash", "[elf]") {
+  // The C library is usually shipped without .symtab, so use the copy this process has loaded
+  auto libc_path = get_libc_path();
+  REQUIRE(!libc_path.empty());
+
+  sdb::elf libc(libc_path);
+  for (auto name : { "malloc", "printf", "getpid" }) {
+    auto syms = libc.get_symbols_by_name(name);
+    REQUIRE(!syms.empty());
+    REQUIRE(libc.get_string(syms[0]->st_name) == name);
+    REQUIRE(syms[0]->st_value != 0);
+  }
+  REQUIRE(libc.get_symbols_by_name("sdb_no_such_symbol").empty());
+}
+
+TEST_CASE("Plain names missing from .gnu.hash don't build the name index", "[elf]") {
+  auto libc_path = get_libc_path();
+  REQUIRE(!libc_path.empty());
+
+  // Building the name index writes it to the cache, so an empty cache shows it wasn't built
+  auto cache_home = std::filesystem::temp_directory_path() / "sdb_test_cache";
+  std::filesystem::remove_all(cache_home);
+  setenv("XDG_CACHE_HOME", cache_home.c_str(), true);
+  auto cache_written = [] {
+    return std::filesystem::exists(index_cache::directory()) and
+      !std::filesystem::is_empty(index_cache::directory());
+  };
+
+  sdb::elf libc(libc_path);
+  REQUIRE(libc.build_id());
+  REQUIRE(libc.get_symbols_by_name("sdb_no_such_symbol").empty());
+  bool written_for_plain_name = cache_written();
+  REQUIRE(libc.get_symbols_by_name("sdb::no_such_symbol()").empty());
+  bool written_for_demangled_name = cache_written();
+
+  unsetenv("XDG_CACHE_HOME");
+  std::filesystem::remove_all(cache_home);
+  REQUIRE(!written_for_plain_name);
+  REQUIRE(written_for_demangled_name);
+}
+
+TEST_CASE("Stripped ELF files find their separate debug file", "[elf]") {
+  sdb::elf full("targets/hello_sdb");
+  sdb::elf stripped("targets/hello_sdb_stripped");
+  REQUIRE(!stripped.get_section(".symtab"));
+  REQUIRE(!stripped.get_section(".debug_info"));
+
+  auto main_sym = stripped.get_symbols_by_name("main");
+  REQUIRE(main_sym.size() == 1);
+  REQUIRE(stripped.debug_file() != nullptr);
+  REQUIRE(stripped.debug_file()->path().filename() == "hello_sdb_stripped.debug");
+  REQUIRE(stripped.get_string(main_sym[0]->st_name) == "main");
+  // The symbol table agrees with the string table names are looked up in
+  REQUIRE(stripped.symbols().size() == full.symbols().size());
+  REQUIRE(std::any_of(stripped.symbols().begin(), stripped.symbols().end(), [&](auto& sym) {
+    return stripped.get_string(sym.st_name) == "main";
+  }));
+  REQUIRE(main_sym[0]->st_value == full.get_symbols_by_name("main").at(0)->st_value);
+
+  // Address lookups follow the stripped file's load bias
+  stripped.notify_loaded(virt_addr{ 0x10000 });
+  auto sym = stripped.get_symbol_containing_address(virt_addr{ 0x10000 + main_sym[0]->st_value + 1 });
+  REQUIRE(sym == main_sym[0]);
+  sym = stripped.get_symbol_at_address(file_addr{ stripped, stripped.get_header().e_entry });
+  REQUIRE(stripped.get_string(sym.value()->st_name) == "_start");
+
+  REQUIRE(stripped.get_section_contents(".debug_info").size() == full.get_section_contents(".debug_info").size());
+
+  // Without the debug file, or with one that fails the checksum, only the stripped file is used
+  auto dir = std::filesystem::temp_directory_path() / "sdb_test_debuglink";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::filesystem::copy_file("targets/hello_sdb_stripped", dir / "hello_sdb_stripped");
+  {
+    sdb::elf alone(dir / "hello_sdb_stripped");
+    REQUIRE(alone.get_symbols_by_name("main").empty());
+    REQUIRE(alone.debug_file() == nullptr);
+  }
+  std::filesystem::copy_file("targets/hello_sdb", dir / "hello_sdb_stripped.debug");
+  {
+    sdb::elf mismatched(dir / "hello_sdb_stripped");
+    REQUIRE(mismatched.debug_file() == nullptr);
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Shared ELF images don't depend on the path they were opened through", "[elf]") {
+  auto proc = process::launch("targets/hello_sdb_stripped");
+  auto exe = std::filesystem::path("/proc") / std::to_string(proc->pid()) / "exe";
+  sdb::elf through_exe(exe);
+  proc.reset();
+
+  // The debug file is found after the process whose exe link opened the file has gone
+  sdb::elf direct("targets/hello_sdb_stripped");
+  REQUIRE(&direct.image() == &through_exe.image());
+  REQUIRE(through_exe.path() == exe);
+  REQUIRE(direct.path() == "targets/hello_sdb_stripped");
+  REQUIRE(direct.image().path() == std::filesystem::canonical("targets/hello_sdb_stripped"));
+  REQUIRE(direct.get_symbols_by_name("main").size() == 1);
+}
+
+TEST_CASE("Compressed debug sections are decompressed on access", "[elf]") {
+  sdb::elf full("targets/hello_sdb");
+  auto expected = full.get_section_data(".debug_info");
+  REQUIRE(expected.owner == nullptr);
+
+  auto equal = [](span<const std::byte> lhs, span<const std::byte> rhs) {
+    return lhs.size() == rhs.size() and std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  };
+
+  auto default_limit = sdb::elf::decompression_cache_limit();
+  for (auto path : { "targets/hello_sdb_zlib", "targets/hello_sdb_zstd" }) {
+    sdb::elf::set_decompression_cache_limit(default_limit);
+    sdb::elf compressed(path);
+    REQUIRE(compressed.get_section(".debug_info").value()->sh_flags & SHF_COMPRESSED);
+
+    auto info = compressed.get_section_data(".debug_info");
+    REQUIRE(info.owner != nullptr);
+    REQUIRE(equal(info.bytes, expected.bytes));
+    // Later lookups are served from the cache
+    REQUIRE(compressed.get_section_data(".debug_info").owner == info.owner);
+
+    // Once over the limit, older sections are dropped but handles to them stay valid
+    sdb::elf::set_decompression_cache_limit(1);
+    auto abbrev = compressed.get_section_data(".debug_abbrev");
+    REQUIRE(equal(abbrev.bytes, full.get_section_contents(".debug_abbrev")));
+    REQUIRE(equal(info.bytes, expected.bytes));
+    auto again = compressed.get_section_data(".debug_info");
+    REQUIRE(again.owner != info.owner);
+    REQUIRE(equal(again.bytes, expected.bytes));
+  }
+  sdb::elf::set_decompression_cache_limit(default_limit);
+
+  sdb::elf prefetched("targets/hello_sdb_zstd", true);
+  REQUIRE(equal(prefetched.get_section_contents(".debug_info"), expected.bytes));
+  REQUIRE(equal(prefetched.get_section_contents(".debug_line"), full.get_section_contents(".debug_line")));
+
+  // A corrupt decompressed size is reported rather than allocated, including from the prefetch thread
+  auto corrupt_path = std::filesystem::temp_directory_path() / "sdb_test_corrupt_zlib";
+  std::filesystem::copy_file("targets/hello_sdb_zlib", corrupt_path, std::filesystem::copy_options::overwrite_existing);
+  {
+    auto offset = sdb::elf("targets/hello_sdb_zlib").get_section(".debug_info").value()->sh_offset;
+    std::fstream file(corrupt_path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset + offsetof(Elf64_Chdr, ch_size));
+    std::uint64_t huge_size = std::uint64_t(1) << 60;
+    file.write(reinterpret_cast<const char*>(&huge_size), sizeof(huge_size));
+  }
+  {
+    sdb::elf corrupt(corrupt_path, true);
+    REQUIRE_THROWS_AS(corrupt.get_section_data(".debug_info"), error);
+    REQUIRE(equal(corrupt.get_section_contents(".debug_abbrev"), full.get_section_contents(".debug_abbrev")));
+  }
+  std::filesystem::remove(corrupt_path);
+}
+
+TEST_CASE("DWARF DIE trees can be walked", "[dwarf]") {
+  for (auto path : { "targets/hello_sdb", "targets/hello_sdb_zstd" }) {
+    sdb::elf elf(path);
+    sdb::dwarf dwarf(elf);
+    REQUIRE(dwarf.compile_units().size() == 1);
+
+    auto root = dwarf.compile_units()[0]->root();
+    REQUIRE(root.tag() == DW_TAG_compile_unit);
+    auto name = root[DW_AT_name].as_string();
+    REQUIRE(name.substr(name.size() - 13) == "hello_sdb.cpp");
+    REQUIRE(root[DW_AT_language].as_int() == DW_LANG_C_plus_plus);
+    REQUIRE_THROWS_AS(root[DW_AT_name].as_address(), error);
+
+    std::optional<die> main;
+    for (auto& child : root.children()) {
+      if (child.tag() == DW_TAG_subprogram and child.contains(DW_AT_name) and child[DW_AT_name].as_string() == "main") {
+        main = child;
+      }
+    }
+    REQUIRE(main);
+
+    auto main_sym = elf.get_symbols_by_name("main").at(0);
+    REQUIRE((*main)[DW_AT_low_pc].as_address().addr() == main_sym->st_value);
+    REQUIRE((*main)[DW_AT_high_pc].as_int() == main_sym->st_size);
+    REQUIRE((*main)[DW_AT_external].as_flag());
+    REQUIRE(!main->contains(DW_AT_bit_size));
+    REQUIRE_THROWS_AS((*main)[DW_AT_bit_size], error);
+
+    auto type = (*main)[DW_AT_type].as_reference();
+    REQUIRE(type.tag() == DW_TAG_base_type);
+    REQUIRE(type[DW_AT_name].as_string() == "int");
+    REQUIRE(type[DW_AT_byte_size].as_int() == 4);
+
+    // Walking into every subtree reaches each DIE exactly once, in order
+    std::size_t count = 0;
+    const std::byte* previous = nullptr;
+    auto walk = [&](auto& self, const die& parent) -> void {
+      for (auto& child : parent.children()) {
+        REQUIRE(child.position() > previous);
+        previous = child.position();
+        ++count;
+        self(self, child);
+      }
+    };
+    walk(walk, root);
+    REQUIRE(count > 100);
+    REQUIRE(dwarf.index().die_count() == count + 1);
+  }
+}
+
+TEST_CASE("Abbreviation tables are looked up by code", "[dwarf]") {
+  sdb::elf elf("targets/hello_sdb");
+  sdb::dwarf dwarf(elf);
+  auto& unit = *dwarf.compile_units()[0];
+  auto& table = unit.abbrev_table();
+  REQUIRE(&table == &dwarf.get_abbrev_table(unit.abbrev_offset()));
+  REQUIRE(table.size() > 10);
+
+  for (std::uint64_t code = 1; code <= table.size(); ++code) {
+    REQUIRE(table.find(code));
+    REQUIRE(table.at(code).code == code);
+  }
+  REQUIRE(!table.find(0));
+  REQUIRE(!table.find(table.size() + 1));
+  REQUIRE_THROWS_AS(table.at(0), error);
+
+  sdb::abbrev_table sparse;
+  sparse.add({ 1, DW_TAG_compile_unit, true, {}, {}, std::nullopt });
+  sparse.add({ 1000000, DW_TAG_base_type, false, {}, {}, std::nullopt });
+  REQUIRE(sparse.size() == 2);
+  REQUIRE(sparse.at(1000000).tag == DW_TAG_base_type);
+  REQUIRE(!sparse.find(999999));
+  REQUIRE_THROWS_AS(sparse.add({ 1, DW_TAG_variable, false, {}, {}, std::nullopt }), error);
+}
+
+TEST_CASE("DWARF indexes find functions, variables and types", "[dwarf]") {
+  sdb::elf elf("targets/hello_sdb");
+  sdb::dwarf dwarf(elf);
+  auto& index = dwarf.index();
+
+  auto mains = index.find_functions("main");
+  REQUIRE(mains.size() == 1);
+  auto low = mains[0][DW_AT_low_pc].as_address();
+  REQUIRE(low.addr() == elf.get_symbols_by_name("main").at(0)->st_value);
+
+  auto containing = index.function_containing_address(low + 1);
+  REQUIRE(containing);
+  REQUIRE(containing->position() == mains[0].position());
+  REQUIRE(!index.function_containing_address(file_addr{ elf, 0 }));
+
+  auto ints = index.find_types("int");
+  REQUIRE(!ints.empty());
+  REQUIRE(ints[0].tag() == DW_TAG_base_type);
+  REQUIRE(index.find_functions("no_such_function").empty());
+  REQUIRE(index.find_variables("main").empty());
+
+  // The results must not depend on how the units were split between threads
+  sdb::dwarf_index serial(dwarf, 1);
+  sdb::dwarf_index parallel(dwarf, 4);
+  REQUIRE(serial.die_count() == parallel.die_count());
+  REQUIRE(serial.die_count() == index.die_count());
+  for (auto name : { "main", "int", "char" }) {
+    auto lhs = serial.find_types(name);
+    auto rhs = parallel.find_types(name);
+    REQUIRE(lhs.size() == rhs.size());
+    for (std::size_t i = 0; i < lhs.size(); ++i) {
+      REQUIRE(lhs[i].position() == rhs[i].position());
+    }
+    REQUIRE(serial.find_functions(name).size() == parallel.find_functions(name).size());
+  }
+}
+
+TEST_CASE("DWARF indexes merge results from several compile units", "[dwarf]") {
+  sdb::elf elf("targets/multi_unit");
+  sdb::dwarf dwarf(elf);
+  REQUIRE(dwarf.compile_units().size() == 3);
+
+  // Three units on three threads leave an odd run over when they are merged in pairs
+  for (std::size_t n_threads : { 1, 2, 3, 8 }) {
+    sdb::dwarf_index index(dwarf, n_threads);
+    REQUIRE(index.die_count() == dwarf.index().die_count());
+
+    for (auto name : { "main", "square", "cube" }) {
+      auto functions = index.find_functions(name);
+      REQUIRE(functions.size() == 1);
+      auto low = functions[0][DW_AT_low_pc].as_address();
+      REQUIRE(index.function_containing_address(low)->position() == functions[0].position());
+    }
+    for (auto name : { "counter", "square_calls", "cube_calls" }) {
+      REQUIRE(index.find_variables(name).size() == 1);
+    }
+    // Each unit has its own int, and they come back in the order of the units
+    auto ints = index.find_types("int");
+    REQUIRE(ints.size() == 3);
+    REQUIRE(ints[0].position() < ints[1].position());
+    REQUIRE(ints[1].position() < ints[2].position());
+  }
+}
+
+TEST_CASE("ELF addresses map to sections, segments and file offsets", "[elf]") {
+  sdb::elf elf("targets/hello_sdb");
+  auto entry = file_addr{ elf, elf.get_header().e_entry };
+
+  auto text = elf.get_section_containing_address(entry);
+  REQUIRE(text);
+  REQUIRE(elf.get_section_name(text->sh_name) == ".text");
+  REQUIRE(elf.get_segment_containing_address(entry)->p_flags & PF_X);
+
+  auto offset = elf.get_file_offset(entry);
+  REQUIRE(offset == text->sh_offset + (entry.addr() - text->sh_addr));
+  REQUIRE(elf.get_file_addr(*offset) == entry);
+
+  // .bss takes up memory but has no contents in the file
+  auto bss = elf.get_section(".bss");
+  REQUIRE(bss);
+  REQUIRE(!elf.get_file_offset(file_addr{ elf, bss.value()->sh_addr }));
+
+  auto bytes = elf.get_bytes(entry, 4);
+  REQUIRE(bytes);
+  REQUIRE(std::equal(bytes->begin(), bytes->end(), elf.get_section_contents(".text").begin() + (entry.addr() - text->sh_addr)));
+
+  auto instructions = sdb::disassembler::disassemble(elf, entry, 3);
+  REQUIRE(instructions.size() == 3);
+  REQUIRE(instructions[0].address == virt_addr{ entry.addr() });
+}
 
 TEST_CASE("Syscall catchpoints work", "[catchpoint]") {
   auto dev_null = open("/dev/null", O_WRONLY);
@@ -362,6 +833,28 @@ TEST_CASE("process::launch no such program", "[process]") {
   REQUIRE_THROWS_AS(process::launch("you_do_not_have_to_be_good"), error);
 }
 
+TEST_CASE("process::launch with arguments and environment", "[process]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+
+  launch_options options;
+  options.args = { "-c", "printf '%s %s %s' \"$1\" \"$SDB_TEST\" \"$(pwd)\"", "sh", "hello" };
+  options.env = std::vector<std::string>{ "SDB_TEST=world" };
+  options.working_directory = "/tmp";
+  options.redirections.push_back({ channel.get_write(), STDOUT_FILENO });
+
+  auto proc = process::launch("sh", options, false);
+  channel.close_write();
+
+  auto reason = proc->wait_on_signal();
+  REQUIRE(reason.reason == process_state::exited);
+  REQUIRE(reason.info == 0);
+  REQUIRE(to_string_view(channel.read()) == "hello world /tmp");
+
+  options.working_directory = "/you_do_not_have_to_be_good";
+  REQUIRE_THROWS_AS(process::launch("sh", options), error);
+}
+
 /* NOTE: 
    In order for this test to pass, 
    the 'tests' exec must be run from within the build/test dir so the path is correct.
@@ -429,6 +922,69 @@ TEST_CASE("Reading and writing memory works", "[memory]") {
   REQUIRE(to_string_view(read) == "Hello, sdb!");
 }
 
+TEST_CASE("Can search process memory", "[memory]") {
+  std::vector<std::byte> haystack(1000, std::byte{ 0xab });
+  std::vector<std::byte> needle{ std::byte{ 1 }, std::byte{ 0xab }, std::byte{ 2 } };
+  for (std::size_t offset : { 0, 31, 34, 500, 997 }) {
+    std::copy(needle.begin(), needle.end(), haystack.begin() + offset);
+  }
+  std::vector<std::size_t> found;
+  sdb::find_all({ haystack.data(), haystack.size() }, { needle.data(), needle.size() }, 600, found);
+  REQUIRE(found == std::vector<std::size_t>{ 0, 31, 34, 500 });
+
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto proc = process::launch("targets/memory", true, channel.get_write());
+  channel.close_write();
+
+  proc->resume();
+  proc->wait_on_signal();
+  auto a_pointer = from_bytes<std::uint64_t>(channel.read().data());
+
+  std::uint64_t value = 0xcafecafe;
+  span<const std::byte> pattern{ as_bytes(value), sizeof(value) };
+
+  auto matches = proc->find(pattern);
+  REQUIRE(std::find(matches.begin(), matches.end(), virt_addr{ a_pointer }) != matches.end());
+  REQUIRE(std::is_sorted(matches.begin(), matches.end()));
+
+  matches = proc->find(pattern, { { virt_addr{ a_pointer - 64 }, virt_addr{ a_pointer + 8 } } });
+  REQUIRE(matches == std::vector<virt_addr>{ virt_addr{ a_pointer } });
+
+  // Software breakpoints must not change what the search sees
+  auto pc = proc->get_pc();
+  auto original = proc->read_memory(pc, 4);
+  proc->create_breakpoint_site(pc).enable();
+  matches = proc->find({ original.data(), original.size() }, { { pc, pc + 4 } });
+  REQUIRE(matches == std::vector<virt_addr>{ pc });
+}
+
+TEST_CASE("Memory snapshots report changed bytes", "[memory]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto proc = process::launch("targets/memory", true, channel.get_write());
+  channel.close_write();
+
+  proc->resume();
+  proc->wait_on_signal();
+  auto a_pointer = from_bytes<std::uint64_t>(channel.read().data());
+
+  auto start = virt_addr{ a_pointer - 3 * memory_snapshot::block_size };
+  auto snapshot = memory_snapshot::take(*proc, { { start, virt_addr{ a_pointer + 64 } } });
+  REQUIRE(snapshot.size() == 3 * memory_snapshot::block_size + 64);
+  REQUIRE(snapshot.stored_bytes() <= 4 * memory_snapshot::block_size);
+  REQUIRE(snapshot.diff(*proc).empty());
+
+  std::uint32_t value = 0xdeadbeef;
+  proc->write_memory(virt_addr{ a_pointer }, { as_bytes(value), sizeof(value) });
+
+  auto changes = snapshot.diff(*proc);
+  REQUIRE(changes.size() == 1);
+  REQUIRE(changes[0].address == virt_addr{ a_pointer });
+  REQUIRE(from_bytes<std::uint32_t>(changes[0].old_data.data()) == 0xcafecafe);
+  REQUIRE(from_bytes<std::uint32_t>(changes[0].new_data.data()) == 0xdeadbeef);
+}
+
 TEST_CASE("Hardware breakpoint evades memory checksums", "[breakpoint]") {
   bool close_on_exec = false;
   sdb::pipe channel(close_on_exec);
@@ -496,3 +1052,424 @@ TEST_CASE("Watchpoint detects read", "[watchpoint]") {
 
   REQUIRE(to_string_view(channel.read()) == "Putting pineapple on pizza...\n");
 }
+
+TEST_CASE("Profiler samples without stopping the inferior", "[profiler]") {
+  auto target = target::launch("targets/run_endlessly");
+  auto& proc = target->get_process();
+
+  profiler prof(proc, 4999);
+  prof.enable();
+  proc.detach();
+
+  for (auto i = 0; i < 5; ++i) {
+    REQUIRE(prof.poll(50));
+  }
+  prof.disable();
+  prof.drain();
+
+  REQUIRE(prof.sample_count() > 0);
+
+  std::stringstream folded;
+  prof.write_folded_stacks(folded, target->get_elf());
+  REQUIRE(folded.str().find("main") != std::string::npos);
+}
+
+TEST_CASE("Core dump contains process memory", "[core]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto proc = process::launch("targets/memory", true, channel.get_write());
+  channel.close_write();
+
+  proc->resume();
+  proc->wait_on_signal();
+  auto a_pointer = from_bytes<std::uint64_t>(channel.read().data());
+
+  auto core_path = std::filesystem::temp_directory_path() / "sdb_test.core";
+  proc->dump_core(core_path);
+
+  sdb::elf core(core_path);
+  REQUIRE(core.get_header().e_type == ET_CORE);
+  REQUIRE(core.get_header().e_phnum > 1);
+
+  std::ifstream file(core_path, std::ios::binary);
+  auto& header = core.get_header();
+  bool found = false;
+  for (auto i = 0; i < header.e_phnum; ++i) {
+    Elf64_Phdr phdr;
+    file.seekg(header.e_phoff + i * sizeof(phdr));
+    file.read(reinterpret_cast<char*>(&phdr), sizeof(phdr));
+
+    if (phdr.p_type == PT_LOAD and phdr.p_vaddr <= a_pointer and a_pointer < phdr.p_vaddr + phdr.p_filesz) {
+      std::uint64_t value;
+      file.seekg(phdr.p_offset + (a_pointer - phdr.p_vaddr));
+      file.read(reinterpret_cast<char*>(&value), sizeof(value));
+      REQUIRE(value == 0xcafecafe);
+      found = true;
+    }
+  }
+  REQUIRE(found);
+
+  std::filesystem::remove(core_path);
+}
+
+TEST_CASE("Can load a core file as a target", "[core]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto live = target::launch("targets/memory", channel.get_write());
+  channel.close_write();
+
+  auto& proc = live->get_process();
+  proc.resume();
+  proc.wait_on_signal();
+  auto a_pointer = from_bytes<std::uint64_t>(channel.read().data());
+
+  auto core_path = std::filesystem::temp_directory_path() / "sdb_test_load.core";
+  proc.dump_core(core_path);
+
+  auto core = target::load_core(core_path, "targets/memory");
+  auto& core_proc = core->get_process();
+
+  REQUIRE(core_proc.is_core());
+  REQUIRE(core_proc.pid() == proc.pid());
+  REQUIRE(core_proc.get_pc() == proc.get_pc());
+  REQUIRE(core_proc.read_memory_as<std::uint64_t>(virt_addr{ a_pointer }) == 0xcafecafe);
+  REQUIRE(core_proc.get_auxv() == proc.get_auxv());
+  REQUIRE(core->get_elf().load_bias() == live->get_elf().load_bias());
+
+  REQUIRE_THROWS_AS(core_proc.resume(), error);
+  REQUIRE_THROWS_AS(core_proc.write_memory(virt_addr{ a_pointer }, { as_bytes("x"), 1 }), error);
+
+  // A core cut short before its notes still loads, just without what the notes held
+  {
+    std::fstream file(core_path, std::ios::in | std::ios::out | std::ios::binary);
+    Elf64_Ehdr header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    auto file_size = std::filesystem::file_size(core_path);
+    for (auto i = 0; i < header.e_phnum; ++i) {
+      Elf64_Phdr phdr;
+      auto phdr_offset = header.e_phoff + i * sizeof(phdr);
+      file.seekg(phdr_offset);
+      file.read(reinterpret_cast<char*>(&phdr), sizeof(phdr));
+      if (phdr.p_type != PT_NOTE) continue;
+
+      phdr.p_offset = file_size + 0x10000;
+      file.seekp(phdr_offset);
+      file.write(reinterpret_cast<const char*>(&phdr), sizeof(phdr));
+    }
+  }
+  sdb::core_file truncated(core_path);
+  REQUIRE(truncated.pid() == 0);
+  REQUIRE(truncated.auxv().empty());
+  REQUIRE(truncated.read_memory(virt_addr{ a_pointer }, 8).size() == 8);
+
+  std::filesystem::remove(core_path);
+}
+
+TEST_CASE("Target tracks shared libraries loaded by the dynamic linker", "[target]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto target = target::launch("targets/memory", channel.get_write());
+  channel.close_write();
+
+  // Nothing beyond the main program is mapped before the dynamic linker runs
+  REQUIRE(target->get_modules().empty());
+
+  auto& proc = target->get_process();
+  proc.resume();
+  auto reason = proc.wait_on_signal();
+  REQUIRE(reason.info == SIGTRAP);
+
+  auto& modules = target->get_modules();
+  auto libc = std::find_if(begin(modules), end(modules), [](auto& module) {
+    return module.path.filename().string().find("libc.so") != std::string::npos;
+  });
+  REQUIRE(libc != end(modules));
+  REQUIRE(libc->start < libc->end);
+
+  // The SIGTRAP was raised from inside libc
+  auto obj = target->get_elf_containing_address(proc.get_pc());
+  REQUIRE(obj != nullptr);
+  REQUIRE(obj->path() == libc->path);
+  REQUIRE(obj->load_bias() == libc->load_bias);
+
+  auto main = target->get_elf().get_symbols_by_name("main");
+  REQUIRE(main.size() == 1);
+  auto main_address = virt_addr{ main[0]->st_value } + target->get_elf().load_bias().addr();
+  REQUIRE(target->get_elf_containing_address(main_address) == &target->get_elf());
+  REQUIRE(target->get_elf_containing_address(virt_addr{ 0 }) == nullptr);
+}
+
+TEST_CASE("The vDSO is parsed from the inferior's memory", "[target]") {
+  auto target = target::launch("targets/run_endlessly");
+  auto& proc = target->get_process();
+  auto base = proc.get_auxv()[AT_SYSINFO_EHDR];
+  REQUIRE(base != 0);
+
+  auto vdso = target->get_vdso();
+  REQUIRE(vdso != nullptr);
+  REQUIRE(vdso == target->get_vdso());
+  REQUIRE(vdso->path() == "[vdso]");
+
+  auto syms = vdso->get_symbols_by_name("__vdso_clock_gettime");
+  REQUIRE(syms.size() == 1);
+  auto address = vdso->load_bias() + syms[0]->st_value;
+  REQUIRE(address.addr() >= base);
+  REQUIRE(target->get_elf_containing_address(address) == vdso);
+
+  // clock_gettime is an alias at the same address, so either name may be found
+  auto sym = vdso->get_symbol_containing_address(address + 1);
+  REQUIRE(sym);
+  REQUIRE(sym.value()->st_value == syms[0]->st_value);
+}
+
+TEST_CASE("Can restart from a checkpoint", "[checkpoint]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  auto proc = process::launch("targets/memory", true, channel.get_write());
+  channel.close_write();
+
+  proc->resume();
+  proc->wait_on_signal();
+  auto a_pointer = virt_addr{ from_bytes<std::uint64_t>(channel.read().data()) };
+
+  auto original_pid = proc->pid();
+  auto pc = proc->get_pc();
+  auto id = proc->create_checkpoint();
+  REQUIRE(proc->checkpoints().size() == 1);
+
+  proc->write_memory(a_pointer, { as_bytes(std::uint64_t{ 0xdeadbeef }), 8 });
+  REQUIRE(proc->read_memory_as<std::uint64_t>(a_pointer) == 0xdeadbeef);
+
+  for (auto i = 0; i < 2; ++i) {
+    proc->restart_checkpoint(id);
+    REQUIRE(proc->pid() != original_pid);
+    REQUIRE(proc->get_pc() == pc);
+    REQUIRE(proc->read_memory_as<std::uint64_t>(a_pointer) == 0xcafecafe);
+    proc->write_memory(a_pointer, { as_bytes(std::uint64_t{ 0xdeadbeef }), 8 });
+  }
+
+  proc->resume();
+  auto reason = proc->wait_on_signal();
+  REQUIRE(reason.reason == process_state::stopped);
+  REQUIRE(reason.info == SIGTRAP);
+
+  proc->delete_checkpoint(id);
+  REQUIRE(proc->checkpoints().empty());
+
+  // Restarting would kill a process that sdb doesn't own
+  auto target = process::launch("targets/run_endlessly", false);
+  auto attached = process::attach(target->pid());
+  REQUIRE_THROWS_AS(attached->create_checkpoint(), error);
+  REQUIRE_THROWS_AS(attached->restart_checkpoint(1), error);
+}
+
+TEST_CASE("Syscall replay injects recorded results", "[syscall]") {
+  auto run = [](auto start_logging) {
+    bool close_on_exec = false;
+    sdb::pipe channel(close_on_exec);
+    auto proc = process::launch("targets/getrandom", true, channel.get_write());
+    channel.close_write();
+
+    start_logging(*proc);
+    proc->resume();
+    proc->wait_on_signal();
+    proc->resume();
+    auto reason = proc->wait_on_signal();
+    REQUIRE(reason.reason == process_state::exited);
+
+    auto log = proc->get_syscall_log();
+    return std::make_pair(from_bytes<std::uint64_t>(channel.read().data()), log);
+  };
+
+  auto [recorded_value, log] = run([](auto& proc) { proc.start_syscall_recording(); });
+  REQUIRE(!log.empty());
+
+  auto path = std::filesystem::temp_directory_path() / "sdb_test_syscalls.log";
+  log.save(path);
+  auto loaded = syscall_log::load(path);
+  std::filesystem::remove(path);
+  REQUIRE(loaded.size() == log.size());
+
+  auto replayed_value = run([&](auto& proc) { proc.start_syscall_replay(loaded); }).first;
+  REQUIRE(replayed_value == recorded_value);
+}
+
+TEST_CASE("Syscall logs only hold the part of a recvfrom address that fitted", "[syscall]") {
+  auto run = [](auto start_logging) {
+    bool close_on_exec = false;
+    sdb::pipe channel(close_on_exec);
+    auto proc = process::launch("targets/recvfrom", true, channel.get_write());
+    channel.close_write();
+
+    proc->resume();
+    proc->wait_on_signal();
+    start_logging(*proc);
+    proc->resume();
+    auto reason = proc->wait_on_signal();
+    REQUIRE(reason.reason == process_state::exited);
+
+    auto result = channel.read();
+    REQUIRE(result.size() == 2);
+    return std::make_tuple(std::to_integer<int>(result[0]), std::to_integer<int>(result[1]), proc->get_syscall_log());
+  };
+
+  auto [recorded_canary, recorded_length, log] = run([](auto& proc) { proc.start_syscall_recording(); });
+  REQUIRE(recorded_canary == 1);
+  // The kernel reported the full length, which is more than the four bytes it wrote
+  REQUIRE(recorded_length > 4);
+
+  auto recv = std::find_if(log.entries().begin(), log.entries().end(), [](auto& e) { return e.id == SYS_recvfrom; });
+  REQUIRE(recv != log.entries().end());
+  REQUIRE(recv->outputs.size() == 3);
+  REQUIRE(recv->outputs[1].size() == 4);
+
+  auto [replayed_canary, replayed_length, replay_log] = run([&](auto& proc) { proc.start_syscall_replay(log); });
+  REQUIRE(replayed_canary == 1);
+  REQUIRE(replayed_length == recorded_length);
+}
+
+TEST_CASE("Can reverse recorded execution", "[record]") {
+  auto proc = process::launch("targets/reverse");
+  proc->resume();
+  proc->wait_on_signal();
+
+  auto& regs = proc->get_registers();
+  auto value_address = virt_addr{ regs.read_by_id_as<std::uint64_t>(register_id::r13) };
+  auto start_pc = proc->get_pc();
+  auto start_rsp = regs.read_by_id_as<std::uint64_t>(register_id::rsp);
+  auto start_rax = regs.read_by_id_as<std::uint64_t>(register_id::rax);
+  auto start_stack = proc->read_memory_as<std::uint64_t>(virt_addr{ start_rsp - 8 });
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x1111);
+
+  proc->start_recording(1024 * 1024);
+
+  // Stepping forward and back again leaves everything as it was
+  proc->step_instruction();
+  proc->step_instruction();
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x2222);
+  proc->reverse_step_instruction();
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x1111);
+  REQUIRE(regs.read_by_id_as<std::uint64_t>(register_id::rax) == 0x2222);
+  proc->reverse_step_instruction();
+  REQUIRE(proc->get_pc() == start_pc);
+  REQUIRE(regs.read_by_id_as<std::uint64_t>(register_id::rax) == start_rax);
+  REQUIRE(proc->get_execution_log()->empty());
+
+  proc->resume();
+  auto reason = proc->wait_on_signal();
+  REQUIRE(reason.reason == process_state::stopped);
+  REQUIRE(reason.info == SIGTRAP);
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x3333);
+  REQUIRE(proc->read_memory_as<std::uint64_t>(virt_addr{ start_rsp - 8 }) == 0x2222);
+
+  // movq $0x2222, %rax is 7 bytes long, so this is the first store to value
+  auto& site = proc->create_breakpoint_site(start_pc + 7);
+  site.enable();
+  reason = proc->reverse_continue();
+  REQUIRE(reason.trap_reason == trap_type::software_break);
+  REQUIRE(proc->get_pc() == start_pc + 7);
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x1111);
+
+  reason = proc->reverse_continue();
+  REQUIRE(proc->get_execution_log()->empty());
+  REQUIRE(proc->get_pc() == start_pc);
+  REQUIRE(regs.read_by_id_as<std::uint64_t>(register_id::rsp) == start_rsp);
+  REQUIRE(proc->read_memory_as<std::uint64_t>(virt_addr{ start_rsp - 8 }) == start_stack);
+
+  // Execution continues forwards from the restored state
+  proc->stop_recording();
+  site.disable();
+  proc->resume();
+  reason = proc->wait_on_signal();
+  REQUIRE(reason.info == SIGTRAP);
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x3333);
+}
+
+TEST_CASE("Recording leaves breakpoints and syscall stops consistent", "[record]") {
+  auto proc = process::launch("targets/reverse");
+  proc->resume();
+  proc->wait_on_signal();
+
+  auto value_address = virt_addr{ proc->get_registers().read_by_id_as<std::uint64_t>(register_id::r13) };
+
+  proc->set_syscall_catch_policy(syscall_catch_policy::catch_all());
+  REQUIRE_THROWS_AS(proc->start_recording(1024 * 1024), error);
+  proc->set_syscall_catch_policy(syscall_catch_policy::catch_none());
+  proc->start_syscall_recording();
+  REQUIRE_THROWS_AS(proc->start_recording(1024 * 1024), error);
+  proc->stop_syscall_log();
+
+  proc->start_recording(1024 * 1024);
+  REQUIRE_THROWS_AS(proc->set_syscall_catch_policy(syscall_catch_policy::catch_all()), error);
+  REQUIRE_THROWS_AS(proc->start_syscall_recording(), error);
+
+  // A trap over the stored value isn't saved as part of the old value
+  auto& site = proc->create_breakpoint_site(value_address);
+  site.enable();
+  proc->step_instruction();
+  proc->step_instruction();
+  site.disable();
+  proc->reverse_step_instruction();
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x1111);
+
+  // A trap set after the store survives undoing it
+  proc->step_instruction();
+  site.enable();
+  proc->reverse_step_instruction();
+  REQUIRE(proc->read_memory(value_address, 1)[0] == std::byte{ 0xcc });
+  REQUIRE(from_bytes<std::uint64_t>(proc->read_memory_without_traps(value_address, 8).data()) == 0x1111);
+  site.disable();
+  REQUIRE(proc->read_memory_as<std::uint64_t>(value_address) == 0x1111);
+}
+
+TEST_CASE("Target pool hands out independent clones", "[target_pool]") {
+  bool close_on_exec = false;
+  sdb::pipe channel(close_on_exec);
+  launch_options options;
+  options.redirections.push_back({ channel.get_write(), STDOUT_FILENO });
+  target_pool pool("targets/memory", options);
+  channel.close_write();
+
+  auto& tmpl = pool.get_template();
+  auto entry = virt_addr{ tmpl.get_process().get_auxv()[AT_ENTRY] };
+  REQUIRE(tmpl.get_process().get_pc() == entry);
+
+  auto first = pool.acquire();
+  auto second = pool.acquire();
+  REQUIRE(first->get_process().pid() != second->get_process().pid());
+  REQUIRE(first->get_process().pid() != tmpl.get_process().pid());
+  REQUIRE(first->get_process().get_pc() == entry);
+  REQUIRE(first->get_process().inject_syscall(SYS_getpid) == first->get_process().pid());
+  REQUIRE(first->get_process().get_pc() == entry);
+
+  auto run_to_trap = [&](target& t) {
+    t.get_process().resume();
+    auto reason = t.get_process().wait_on_signal();
+    REQUIRE(reason.info == SIGTRAP);
+    return virt_addr{ from_bytes<std::uint64_t>(channel.read().data()) };
+  };
+
+  auto a_pointer = run_to_trap(*first);
+  first->get_process().write_memory(a_pointer, { as_bytes(std::uint64_t{ 0xdeadbeef }), 8 });
+
+  REQUIRE(run_to_trap(*second) == a_pointer);
+  REQUIRE(second->get_process().read_memory_as<std::uint64_t>(a_pointer) == 0xcafecafe);
+  REQUIRE(first->get_process().read_memory_as<std::uint64_t>(a_pointer) == 0xdeadbeef);
+}
+
+TEST_CASE("Pooled targets can wait for their own children", "[target_pool]") {
+  target_pool pool("targets/fork_and_wait");
+  auto target = pool.acquire();
+
+  auto& proc = target->get_process();
+  proc.resume();
+  auto reason = proc.wait_on_signal();
+  // The child's exit is reported to sdb as a SIGCHLD stop first
+  if (reason.reason == process_state::stopped) {
+    REQUIRE(reason.info == SIGCHLD);
+    proc.resume();
+    reason = proc.wait_on_signal();
+  }
+  REQUIRE(reason.reason == process_state::exited);
+  REQUIRE(reason.info == 0);
+}
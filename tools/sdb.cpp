@@ -1,8 +1,13 @@
 #include <algorithm>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <editline/readline.h>
@@ -16,16 +21,35 @@
 #include <libsdb/disassembler.hpp>
 #include <libsdb/process.hpp>
 #include <libsdb/error.hpp>
+#include <libsdb/memory_snapshot.hpp>
 #include <libsdb/parse.hpp>
+#include <libsdb/profiler.hpp>
 #include <libsdb/target.hpp>
 #include <libsdb/syscalls.hpp>
 
 namespace {
   sdb::process* g_sdb_process = nullptr;
 
+  volatile std::sig_atomic_t g_stop_profiling = 0;
+
+  // Command lists attached with "breakpoint commands", keyed by breakpoint site id
+  std::unordered_map<sdb::breakpoint_site::id_type, std::vector<std::string>> g_breakpoint_commands;
+  // Commands queued by a stop, which run once the command that caused the stop returns
+  std::deque<std::string> g_pending_commands;
+  std::optional<sdb::stop_reason> g_last_stop;
+  // Taken by "memory snapshot" and compared against by "memory diff"
+  std::optional<sdb::memory_snapshot> g_memory_snapshot;
+
+  // Produces the next command line, or nothing once input runs out
+  using line_source = std::function<std::optional<std::string>(const char* prompt)>;
+
   void handle_sigint(int) {
     kill(g_sdb_process->pid(), SIGSTOP);
   }
+
+  void handle_profile_sigint(int) {
+    g_stop_profiling = 1;
+  }
   
   bool is_prefix(std::string_view str, std::string_view of) {
     if (str.size() > of.size()) return false;
@@ -37,11 +61,19 @@ namespace {
     if (args.size() == 1) {
       std::cerr << R"(Available Commands:
     breakpoint  - Commands for operating on breakpoints
+    checkpoint  - Commands for operating on checkpoints
     continue    - Resume the process
     disassemble - Disassemble machine code to assembly
+    gcore       - Write a core file of the process
     memory      - Commands for operating on memory
+    modules     - List the loaded shared libraries
+    record      - Record execution so it can be reversed
     register    - Commands for operating on registers
+    restart     - Restart the process from a checkpoint
+    reverse-continue - Run backwards to the previous breakpoint
+    reverse-stepi    - Step back over a single recorded instruction
     step        - Step over a single instruction
+    syscall     - Record or replay syscall results
     watchpoint  - Commands for operating on watchpoints
     catchpoint  - Commands for operating on catchpoints
 )";
@@ -53,6 +85,7 @@ namespace {
     enable <id>
     set <address>
     set <address> -h
+    commands <id>, followed by one command per line and "end"
 )";
     } else if (is_prefix(args[1], "register")) {
       std::cerr << R"(Available Commands:
@@ -66,6 +99,41 @@ namespace {
     read <address>
     read <address> <number of bytes>
     write <address> <bytes>
+    find bytes <bytes>
+    find string <text>
+    find int <value> [size]
+    snapshot
+    snapshot <address> <number of bytes>
+    diff
+)";
+    } else if (is_prefix(args[1], "checkpoint")) {
+      std::cerr << R"(Available Commands:
+    checkpoint
+    checkpoint list
+    checkpoint delete <id>
+)";
+    } else if (is_prefix(args[1], "restart")) {
+      std::cerr << R"(Usage:
+    restart <checkpoint id>
+)";
+    } else if (is_prefix(args[1], "record")) {
+      std::cerr << R"(Available Commands:
+    record
+    record <buffer size in MiB>
+    record stop
+    record info
+)";
+    } else if (is_prefix(args[1], "syscall")) {
+      std::cerr << R"(Available Commands:
+    record
+    replay <file>
+    save <file>
+    off
+)";
+    } else if (is_prefix(args[1], "gcore")) {
+      std::cerr << R"(Usage:
+    gcore
+    gcore <path>
 )";
     } else if (is_prefix(args[1], "disassemble")) {
       std::cerr << R"(Available options:
@@ -152,9 +220,11 @@ namespace {
       process.get_pc().addr()
     );
 
-    auto func = target.get_elf().get_symbol_containing_address(process.get_pc());
-    if (func and ELF64_ST_TYPE(func.value()->st_info) == STT_FUNC) {
-      message += fmt::format(" ({})", target.get_elf().get_string(func.value()->st_name));
+    if (auto obj = target.get_elf_containing_address(process.get_pc())) {
+      auto func = obj->get_symbol_containing_address(process.get_pc());
+      if (func and ELF64_ST_TYPE(func.value()->st_info) == STT_FUNC) {
+        message += fmt::format(" ({})", obj->get_string(func.value()->st_name));
+      }
     }
 
     if (reason.info == SIGTRAP) {
@@ -190,11 +260,35 @@ namespace {
     }
   }
 
+  std::optional<sdb::breakpoint_site::id_type> get_stopped_breakpoint(const sdb::process& process, sdb::stop_reason reason) {
+    if (reason.reason != sdb::process_state::stopped or reason.info != SIGTRAP) return std::nullopt;
+
+    if (reason.trap_reason == sdb::trap_type::software_break) {
+      // Traps the inferior raised itself, such as a compiled-in int3, aren't at a site
+      auto& sites = process.breakpoint_sites();
+      if (!sites.contains_address(process.get_pc())) return std::nullopt;
+      return sites.get_by_address(process.get_pc()).id();
+    }
+    if (reason.trap_reason == sdb::trap_type::hardware_break) {
+      auto id = process.get_current_hardware_stoppoint();
+      if (id.index() == 0) return std::get<0>(id);
+    }
+    return std::nullopt;
+  }
+
   void handle_stop(sdb::target& target, sdb::stop_reason reason) {
+    g_last_stop = reason;
     print_stop_reason(target, reason);
     if (reason.reason == sdb::process_state::stopped) {
       print_disassembly(target.get_process(), target.get_process().get_pc(), 5);
     }
+
+    if (auto id = get_stopped_breakpoint(target.get_process(), reason)) {
+      auto commands = g_breakpoint_commands.find(*id);
+      if (commands != end(g_breakpoint_commands)) {
+        g_pending_commands.insert(end(g_pending_commands), begin(commands->second), end(commands->second));
+      }
+    }
   }
 
   sdb::registers::value parse_register_value(sdb::register_info info, std::string_view text) {
@@ -328,11 +422,128 @@ namespace {
     for (std::size_t i = 0; i < data.size(); i += 16) {
       auto start = data.begin() + i;
       auto end = data.begin() + std::min(i + 16, data.size());
-      fmt::print("{:#016x}: {:02x}\n", *address + i, fmt::join(start, end, " "));
+      fmt::print("{:#018x}: {:02x}\n", *address + i, fmt::join(start, end, " "));
+    }
+  }
+
+  void handle_memory_find_command(sdb::process& process, const std::vector<std::string>& args) {
+    if (args.size() < 4) {
+      print_help({ "help", "memory" });
+      return;
+    }
+
+    std::vector<std::byte> pattern;
+    if (is_prefix(args[2], "bytes")) {
+      pattern = sdb::parse_vector(args[3]);
+    } else if (is_prefix(args[2], "string")) {
+      // The line was split on spaces, so put the text back together
+      std::string text = args[3];
+      for (auto it = args.begin() + 4; it != args.end(); ++it) {
+        text += ' ' + *it;
+      }
+      auto bytes = reinterpret_cast<const std::byte*>(text.data());
+      pattern.assign(bytes, bytes + text.size());
+    } else if (is_prefix(args[2], "int")) {
+      auto value = args[3].rfind("0x", 0) == 0 ?
+        sdb::to_integral<std::uint64_t>(args[3], 16) :
+        sdb::to_integral<std::uint64_t>(args[3]);
+      if (!value) sdb::error::send("Invalid integer");
+
+      std::size_t size = 4;
+      if (args.size() > 4) {
+        auto size_arg = sdb::to_integral<std::size_t>(args[4]);
+        if (!size_arg or (*size_arg != 1 and *size_arg != 2 and *size_arg != 4 and *size_arg != 8)) {
+          sdb::error::send("Integer size must be 1, 2, 4, or 8");
+        }
+        size = *size_arg;
+      }
+      auto bytes = sdb::as_bytes(*value);
+      pattern.assign(bytes, bytes + size);
+    } else {
+      print_help({ "help", "memory" });
+      return;
+    }
+
+    auto matches = process.find({ pattern.data(), pattern.size() });
+    for (auto address : matches) {
+      fmt::print("{:#018x}\n", address.addr());
+    }
+    fmt::print("{} match{}\n", matches.size(), matches.size() == 1 ? "" : "es");
+  }
+
+  void handle_memory_snapshot_command(sdb::process& process, const std::vector<std::string>& args) {
+    std::vector<sdb::address_range> ranges;
+
+    if (args.size() == 4) {
+      auto address = sdb::to_integral<std::uint64_t>(args[2], 16);
+      if (!address) sdb::error::send("Invalid address format");
+      auto size = sdb::to_integral<std::size_t>(args[3]);
+      if (!size) sdb::error::send("Invalid number of bytes");
+      ranges.push_back({ sdb::virt_addr{ *address }, sdb::virt_addr{ *address + *size } });
+    } else if (args.size() == 2) {
+      // Everything the process could have written to, other than memory shared with other processes
+      for (auto& region : process.get_memory_regions()) {
+        if (region.readable and region.writable and !region.shared and region.path != "[vvar]") {
+          ranges.push_back({ region.start, region.end });
+        }
+      }
+    } else {
+      print_help({ "help", "memory" });
+      return;
     }
+
+    g_memory_snapshot = sdb::memory_snapshot::take(process, ranges);
+    fmt::print("Took snapshot of {} bytes in {} range{} ({} bytes stored)\n",
+      g_memory_snapshot->size(), ranges.size(), ranges.size() == 1 ? "" : "s",
+      g_memory_snapshot->stored_bytes());
   }
 
-  void handle_memory_command(sdb::process& process, const std::vector<std::string>& args) {
+  void handle_memory_diff_command(sdb::target& target) {
+    if (!g_memory_snapshot) sdb::error::send("No memory snapshot has been taken");
+
+    auto& elf = target.get_elf();
+    auto changes = g_memory_snapshot->diff(target.get_process());
+
+    auto print_bytes = [](const char* label, const std::vector<std::byte>& data) {
+      constexpr std::size_t max_shown = 16;
+      auto shown = std::min(data.size(), max_shown);
+      fmt::print("  {}: {:02x}{}\n", label, fmt::join(data.begin(), data.begin() + shown, " "),
+        data.size() > shown ? " ..." : "");
+    };
+
+    for (auto& change : changes) {
+      fmt::print("{:#018x}: {} byte{}", change.address.addr(),
+        change.old_data.size(), change.old_data.size() == 1 ? "" : "s");
+
+      // Name the variable that changed when the address is in one of the executable's data sections
+      auto section = elf.get_section_containing_address(change.address);
+      if (section and (section->sh_flags & SHF_ALLOC) and !(section->sh_flags & SHF_EXECINSTR)) {
+        auto sym = elf.get_symbol_containing_address(change.address);
+        if (sym and sym.value()->st_name != 0) {
+          auto offset = change.address.to_file_addr(elf).addr() - sym.value()->st_value;
+          fmt::print(" in {}+{:#x}", elf.get_string(sym.value()->st_name), offset);
+        }
+        fmt::print(" ({})", elf.get_section_name(section->sh_name));
+      }
+      fmt::print("\n");
+
+      print_bytes("old", change.old_data);
+      print_bytes("new", change.new_data);
+    }
+    fmt::print("{} changed range{}\n", changes.size(), changes.size() == 1 ? "" : "s");
+  }
+
+  void handle_memory_command(sdb::target& target, const std::vector<std::string>& args) {
+    auto& process = target.get_process();
+
+    if (args.size() >= 2 and is_prefix(args[1], "snapshot")) {
+      handle_memory_snapshot_command(process, args);
+      return;
+    } else if (args.size() == 2 and is_prefix(args[1], "diff")) {
+      handle_memory_diff_command(target);
+      return;
+    }
+
     if (args.size() < 3) {
       print_help({ "help", "memory" });
       return;
@@ -342,6 +553,8 @@ namespace {
       handle_memory_read_command(process, args);
     } else if (is_prefix(args[1], "write")) {
       handle_memory_write_command(process, args);
+    } else if (is_prefix(args[1], "find")) {
+      handle_memory_find_command(process, args);
     } else {
       print_help({ "help", "memory" });
     }
@@ -424,7 +637,7 @@ namespace {
     process.create_watchpoint(sdb::virt_addr{ *address }, mode, *size).enable();
   }
 
-  void handle_breakpoint_command(sdb::process& process, const std::vector<std::string>& args) {
+  void handle_breakpoint_command(sdb::process& process, const std::vector<std::string>& args, const line_source& source) {
     if (args.size() < 2) {
       print_help({ "help", "breakpoint" });
       return;
@@ -489,6 +702,22 @@ namespace {
       process.breakpoint_sites().get_by_id(*id).disable();
     } else if (is_prefix(command, "delete")) {
       process.breakpoint_sites().remove_by_id(*id);
+      g_breakpoint_commands.erase(*id);
+    } else if (is_prefix(command, "commands")) {
+      // Validates the id before reading the command list
+      process.breakpoint_sites().get_by_id(*id);
+
+      std::vector<std::string> commands;
+      while (auto line = source(">")) {
+        if (*line == "end") break;
+        commands.push_back(*line);
+      }
+
+      if (commands.empty()) {
+        g_breakpoint_commands.erase(*id);
+      } else {
+        g_breakpoint_commands[*id] = std::move(commands);
+      }
     }
   }
 
@@ -553,6 +782,85 @@ namespace {
     }
   }
 
+  void handle_checkpoint_command(sdb::process& process, const std::vector<std::string>& args) {
+    if (args.size() == 1) {
+      auto id = process.create_checkpoint();
+      fmt::print("Created checkpoint {} at {:#x}\n", id, process.get_pc().addr());
+      return;
+    }
+
+    if (is_prefix(args[1], "list")) {
+      if (process.checkpoints().empty()) {
+        fmt::print("No checkpoints\n");
+      }
+      for (auto& point : process.checkpoints()) {
+        fmt::print("{}: pc = {:#x}, pid = {}\n", point.id, point.pc.addr(), point.pid);
+      }
+    } else if (is_prefix(args[1], "delete") and args.size() == 3) {
+      auto id = sdb::to_integral<int>(args[2]);
+      if (!id) sdb::error::send("Command expects checkpoint id");
+      process.delete_checkpoint(*id);
+    } else {
+      print_help({ "help", "checkpoint" });
+    }
+  }
+
+  void handle_restart_command(sdb::target& target, const std::vector<std::string>& args) {
+    if (args.size() != 2) {
+      print_help({ "help", "restart" });
+      return;
+    }
+
+    auto id = sdb::to_integral<int>(args[1]);
+    if (!id) sdb::error::send("Command expects checkpoint id");
+
+    auto& process = target.get_process();
+    process.restart_checkpoint(*id);
+    fmt::print("Restarted from checkpoint {} as process {}\n", *id, process.pid());
+    print_disassembly(process, process.get_pc(), 5);
+  }
+
+  void handle_syscall_log_command(sdb::process& process, const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+      print_help({ "help", "syscall" });
+      return;
+    }
+
+    if (is_prefix(args[1], "record")) {
+      process.start_syscall_recording();
+    } else if (is_prefix(args[1], "replay") and args.size() == 3) {
+      auto log = sdb::syscall_log::load(args[2]);
+      fmt::print("Replaying {} syscall results\n", log.size());
+      process.start_syscall_replay(std::move(log));
+    } else if (is_prefix(args[1], "save") and args.size() == 3) {
+      process.get_syscall_log().save(args[2]);
+      fmt::print("Saved {} syscall results to {}\n", process.get_syscall_log().size(), args[2]);
+    } else if (is_prefix(args[1], "off")) {
+      process.stop_syscall_log();
+    } else {
+      print_help({ "help", "syscall" });
+    }
+  }
+
+  void handle_record_command(sdb::process& process, const std::vector<std::string>& args) {
+    if (args.size() == 1) {
+      process.start_recording();
+    } else if (is_prefix(args[1], "stop")) {
+      process.stop_recording();
+    } else if (is_prefix(args[1], "info")) {
+      auto log = process.get_execution_log();
+      if (!log) {
+        fmt::print("Not recording\n");
+        return;
+      }
+      fmt::print("{} instructions recorded in {} of {} bytes\n", log->size(), log->bytes_used(), log->capacity());
+    } else if (auto mib = sdb::to_integral<std::size_t>(args[1])) {
+      process.start_recording(*mib * 1024 * 1024);
+    } else {
+      print_help({ "help", "record" });
+    }
+  }
+
   void handle_catchpoint_command(sdb::process& process, const std::vector<std::string>& args) {
     if (args.size() < 2) {
       print_help({ "help", "catchpoint" });
@@ -564,7 +872,7 @@ namespace {
     }
   }
   
-  void handle_command(std::unique_ptr<sdb::target>& target, std::string_view line) {
+  void handle_command(std::unique_ptr<sdb::target>& target, std::string_view line, const line_source& source) {
     auto args = split(line, ' ');
     auto command = args[0];
     auto process = &target->get_process();
@@ -578,9 +886,13 @@ namespace {
     } else if (is_prefix(command, "register")) {
       handle_register_command(*process, args);
     } else if (is_prefix(command, "breakpoint")) {
-        handle_breakpoint_command(*process, args);
+        handle_breakpoint_command(*process, args, source);
     } else if (is_prefix(command, "memory")) {
-        handle_memory_command(*process, args);
+        handle_memory_command(*target, args);
+    } else if (is_prefix(command, "modules")) {
+      for (auto& module : target->get_modules()) {
+        fmt::print("{:#018x}-{:#018x} {}\n", module.start.addr(), module.end.addr(), module.path.string());
+      }
     } else if (is_prefix(command, "step")) {
         auto reason = process->step_instruction();
         handle_stop(*target, reason);
@@ -590,12 +902,59 @@ namespace {
       handle_watchpoint_command(*process, args);      
     } else if (is_prefix(command, "catchpoint")) {
       handle_catchpoint_command(*process, args);      
+    } else if (command == "record") {
+      handle_record_command(*process, args);
+    } else if (command == "reverse-stepi" or command == "rsi") {
+      auto reason = process->reverse_step_instruction();
+      handle_stop(*target, reason);
+    } else if (command == "reverse-continue" or command == "rc") {
+      auto reason = process->reverse_continue();
+      handle_stop(*target, reason);
+      if (process->get_execution_log()->empty()) {
+        fmt::print("Reached the start of the recording\n");
+      }
+    } else if (is_prefix(command, "syscall")) {
+      handle_syscall_log_command(*process, args);
+    } else if (is_prefix(command, "checkpoint")) {
+      handle_checkpoint_command(*process, args);
+    } else if (is_prefix(command, "restart")) {
+      handle_restart_command(*target, args);
+    } else if (is_prefix(command, "gcore")) {
+      auto path = args.size() > 1 ? args[1] : fmt::format("core.{}", process->pid());
+      process->dump_core(path);
+      fmt::print("Saved core file to {}\n", path);
     } else {
-      std::cerr << "Unknown command '" << command << "' \n";
+      sdb::error::send("Unknown command '" + std::string(command) + "'");
     }
   }
   
+  std::string trim(std::string_view str) {
+    auto start = str.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) return "";
+    auto end = str.find_last_not_of(" \t\r");
+    return std::string(str.substr(start, end - start + 1));
+  }
+
+  // Runs a command followed by anything it queued, such as the command list of a breakpoint it hit
+  void run_command(std::unique_ptr<sdb::target>& target, std::string_view line, const line_source& source) {
+    handle_command(target, line, source);
+
+    while (!g_pending_commands.empty()) {
+      auto next = std::move(g_pending_commands.front());
+      g_pending_commands.pop_front();
+      handle_command(target, next, source);
+    }
+  }
+
   void main_loop(std::unique_ptr<sdb::target>& target) {
+    line_source source = [](const char* prompt) -> std::optional<std::string> {
+      auto line = readline(prompt);
+      if (!line) return std::nullopt;
+      auto ret = trim(line);
+      free(line);
+      return ret;
+    };
+
     char* line = nullptr;
     while ((line = readline("sdb> ")) != nullptr) {
       std::string line_str;
@@ -615,26 +974,147 @@ namespace {
 
       if (!line_str.empty()) {
         try {
-          handle_command(target, line_str);
+          run_command(target, line_str, source);
         }
         catch (const sdb::error& err) {
+          g_pending_commands.clear();
           std::cout << err.what() << '\n';
         }
       }
     }
   }
 
+  /*
+    Runs each line of a command script. Blank lines and lines starting
+    with '#' are skipped. Stops at the first failing command and returns false.
+  */
+  bool run_script(std::unique_ptr<sdb::target>& target, std::istream& script, std::string_view name) {
+    int line_number = 0;
+    line_source source = [&](const char*) -> std::optional<std::string> {
+      std::string line;
+      while (std::getline(script, line)) {
+        ++line_number;
+        auto trimmed = trim(line);
+        if (!trimmed.empty() and trimmed[0] != '#') return trimmed;
+      }
+      return std::nullopt;
+    };
+
+    while (auto line = source("")) {
+      try {
+        run_command(target, *line, source);
+      } catch (const sdb::error& err) {
+        g_pending_commands.clear();
+        fmt::print("{}:{}: {}\n", name, line_number, err.what());
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Mirrors a shell: the inferior's exit code, or 128 + the signal that killed it
+  int get_inferior_exit_status() {
+    if (!g_last_stop) return 0;
+    if (g_last_stop->reason == sdb::process_state::exited) return g_last_stop->info;
+    if (g_last_stop->reason == sdb::process_state::terminated) return 128 + g_last_stop->info;
+    return 0;
+  }
+
   std::unique_ptr<sdb::target> attach(int argc, const char** argv) {
     if (argc == 3 && argv[1] == std::string_view("-p")) {
       pid_t pid = std::atoi(argv[2]);
       return sdb::target::attach(pid);
+    } else if (argc == 4 && argv[1] == std::string_view("-c")) {
+      auto target = sdb::target::load_core(argv[2], argv[3]);
+      auto& process = target->get_process();
+      fmt::print("Loaded core file for PID {}\n", process.pid());
+      fmt::print("{:#018x}: stopped", process.get_pc().addr());
+      if (auto obj = target->get_elf_containing_address(process.get_pc())) {
+        auto func = obj->get_symbol_containing_address(process.get_pc());
+        if (func and ELF64_ST_TYPE(func.value()->st_info) == STT_FUNC) {
+          fmt::print(" in {}", obj->get_string(func.value()->st_name));
+        }
+      }
+      fmt::print("\n");
+      return target;
     } else {
       const char* program_path = argv[1];
-      auto target = sdb::target::launch(program_path);
+      sdb::launch_options options;
+      options.args.assign(argv + 2, argv + argc);
+      auto target = sdb::target::launch(program_path, options);
       fmt::print("Launched process with PID {}\n", target->get_process().pid());
       return target;
     }
   }
+
+  /*
+    sdb profile [-F <frequency>] [-o <output>] (-p <pid> | <program> [args...])
+
+    Samples the inferior with perf_event_open and writes folded stacks.
+    Once the sampling event is attached sdb detaches ptrace entirely,
+    so the inferior runs without ever stopping for the debugger.
+  */
+  int run_profiler(int argc, const char** argv) {
+    std::uint64_t frequency = 999;
+    const char* output_path = nullptr;
+    std::optional<pid_t> pid;
+
+    int i = 2;
+    for (; i + 1 < argc and argv[i][0] == '-'; i += 2) {
+      std::string_view flag = argv[i];
+      if (flag == "-F") {
+        auto freq = sdb::to_integral<std::uint64_t>(argv[i + 1]);
+        if (!freq) sdb::error::send("Invalid sampling frequency");
+        frequency = *freq;
+      } else if (flag == "-o") {
+        output_path = argv[i + 1];
+      } else if (flag == "-p") {
+        auto opt_pid = sdb::to_integral<pid_t>(argv[i + 1]);
+        if (!opt_pid) sdb::error::send("Invalid pid");
+        pid = *opt_pid;
+      } else {
+        sdb::error::send("Unknown profile option");
+      }
+    }
+
+    if (!pid and i >= argc) {
+      std::cerr << "Usage: sdb profile [-F <frequency>] [-o <output>] (-p <pid> | <program> [args...])\n";
+      return -1;
+    }
+
+    sdb::launch_options options;
+    if (!pid) options.args.assign(argv + i + 1, argv + argc);
+    auto target = pid ? sdb::target::attach(*pid) : sdb::target::launch(argv[i], options);
+    auto& process = target->get_process();
+
+    sdb::profiler profiler(process, frequency);
+    profiler.enable();
+    signal(SIGINT, handle_profile_sigint);
+    process.detach();
+
+    bool running = true;
+    while (!g_stop_profiling and running) {
+      running = profiler.poll(/*timeout_ms=*/100);
+    }
+
+    profiler.disable();
+    profiler.drain();
+
+    // Reap the inferior if it ran to completion; otherwise the target cleans it up
+    if (!running and !pid) process.wait_on_signal();
+
+    fmt::print(stderr, "Collected {} samples ({} lost)\n", profiler.sample_count(), profiler.lost_count());
+
+    if (output_path) {
+      std::ofstream out(output_path);
+      profiler.write_folded_stacks(out, target->get_elf());
+    } else {
+      profiler.write_folded_stacks(std::cout, target->get_elf());
+    }
+
+    return 0;
+  }
 }
 
 int main(int argc, const char** argv) {
@@ -643,12 +1123,70 @@ int main(int argc, const char** argv) {
     return -1;
   }
 
+  if (argv[1] == std::string_view("profile")) {
+    try {
+      return run_profiler(argc, argv);
+    } catch (const sdb::error& err) {
+      std::cout << err.what() << '\n';
+      return -1;
+    }
+  }
+
+  /*
+    sdb [-x <script>]... [--batch] <target>
+
+    Scripts run in order before the prompt appears. With --batch there is no prompt:
+    commands come from the scripts, or from stdin if none were given, and sdb exits
+    with the inferior's status once they have run.
+  */
+  std::vector<std::string> scripts;
+  bool batch = false;
+  int first = 1;
+  while (first < argc) {
+    std::string_view arg = argv[first];
+    if (arg == "-x" and first + 1 < argc) {
+      scripts.push_back(argv[first + 1]);
+      first += 2;
+    } else if (arg == "--batch") {
+      batch = true;
+      ++first;
+    } else {
+      break;
+    }
+  }
+
+  if (first == argc) {
+    std::cerr << "No target given\n";
+    return -1;
+  }
+
+  std::vector<const char*> target_args{ argv[0] };
+  target_args.insert(end(target_args), argv + first, argv + argc);
+
   try {
-    auto target = attach(argc, argv);
+    auto target = attach(target_args.size(), target_args.data());
     g_sdb_process = &target->get_process();
-    signal(SIGINT, handle_sigint);
-    main_loop(target);
+    if (!g_sdb_process->is_core()) {
+      signal(SIGINT, handle_sigint);
+    }
+
+    for (auto& path : scripts) {
+      std::ifstream script(path);
+      if (!script) sdb::error::send("Could not open script " + path);
+      if (!run_script(target, script, path) and batch) return 1;
+    }
+
+    if (!batch) {
+      main_loop(target);
+      return 0;
+    }
+
+    if (scripts.empty() and !run_script(target, std::cin, "<stdin>")) {
+      return 1;
+    }
+    return get_inferior_exit_status();
   } catch (const sdb::error& err) {
     std::cout<< err.what() << '\n';
+    return -1;
   }
 }